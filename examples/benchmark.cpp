@@ -0,0 +1,680 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+// Headless benchmarks of the scan, sort and format paths; no window
+// is shown. The stages that need a table or a tree (and with that
+// fonts) only run if $DISPLAY is set, e.g. under Xvfb:
+//
+//   benchmark [--json] [--huge] [--dir=PATH] [count]
+//
+// --json   print one JSON object per result for regression tracking
+// --huge   add a fixture with a million files
+// --dir    where the synthetic directories are created; the default
+//          is /dev/shm (a tmpfs on most Linux systems) or /tmp
+// count    number of values to format (default: 10 million)
+//
+// The exit status is 1 if any result is wrong.
+
+#include <FL/Fl.H>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fltk_dirscan.hpp"
+#include "fltk_dirtree.hpp"
+#include "fltk_filetable_simple.hpp"
+#include "rgba_blend.hpp"
+
+
+typedef std::chrono::steady_clock clk;
+
+static double elapsed_ms(clk::time_point start) {
+  return std::chrono::duration<double, std::milli>(clk::now() - start).count();
+}
+
+
+// count all heap allocations, including the ones of strdup()
+// and operator new; glibc allows replacing malloc() like this
+static std::atomic<long> g_allocs(0);
+static std::atomic<long> g_alloc_bytes(0);
+
+#ifdef __GLIBC__
+#define COUNT_ALLOCS 1
+
+extern "C" {
+  void *__libc_malloc(size_t);
+  void *__libc_calloc(size_t, size_t);
+  void *__libc_realloc(void *, size_t);
+  void __libc_free(void *);
+
+  void *malloc(size_t n) {
+    g_allocs++;
+    g_alloc_bytes += n;
+    return __libc_malloc(n);
+  }
+
+  void *calloc(size_t n, size_t size) {
+    g_allocs++;
+    g_alloc_bytes += n * size;
+    return __libc_calloc(n, size);
+  }
+
+  void *realloc(void *p, size_t n) {
+    g_allocs++;
+    g_alloc_bytes += n;
+    return __libc_realloc(p, n);
+  }
+
+  void free(void *p) {
+    __libc_free(p);
+  }
+}
+#else
+#define COUNT_ALLOCS 0
+#endif
+
+
+typedef struct {
+  const char *bench;    // group of stages
+  std::string fixture;  // input data
+  const char *stage;
+  double ms;
+  long items;           // entries, values or pixels processed
+  long stat_calls;      // -1 if unknown
+  long allocs;          // -1 if unknown
+  long alloc_bytes;
+  bool ok;              // the result is correct
+} result_t;
+
+static bool g_json = false;
+static bool g_failed = false;
+
+// print a line of information that isn't a result
+static void info(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(g_json ? stderr : stdout, fmt, args);
+  va_end(args);
+}
+
+static void report(const result_t &r)
+{
+  if (!r.ok) g_failed = true;
+
+  if (g_json) {
+    printf("{\"bench\":\"%s\",\"fixture\":\"%s\",\"stage\":\"%s\",\"ms\":%.3f,\"items\":%ld,"
+           "\"stat_calls\":%ld,\"allocs\":%ld,\"alloc_bytes\":%ld,\"ok\":%s}\n",
+           r.bench, r.fixture.c_str(), r.stage, r.ms, r.items, r.stat_calls,
+           r.allocs, r.alloc_bytes, r.ok ? "true" : "false");
+    return;
+  }
+
+  char stat_calls[32] = "-";
+  if (r.stat_calls >= 0) snprintf(stat_calls, sizeof(stat_calls), "%ld", r.stat_calls);
+
+  printf("%-8s %-12s %-20s %10.2f ms %10ld items %10s stat %9ld allocs %12ld bytes%s\n",
+         r.bench, r.fixture.c_str(), r.stage, r.ms, r.items, stat_calls,
+         r.allocs, r.alloc_bytes, r.ok ? "" : "  MISMATCH");
+}
+
+// time a stage and count its allocations
+class measure
+{
+  clk::time_point start_;
+  long allocs_, bytes_;
+
+public:
+  measure() {
+    allocs_ = g_allocs;
+    bytes_ = g_alloc_bytes;
+    start_ = clk::now();
+  }
+
+  void done(const char *bench, const std::string &fixture, const char *stage,
+            long items, long stat_calls=-1, bool ok=true)
+  {
+    const double ms = elapsed_ms(start_);
+    const long allocs = COUNT_ALLOCS ? g_allocs - allocs_ : -1;
+    const long bytes = COUNT_ALLOCS ? g_alloc_bytes - bytes_ : -1;
+
+    report({ bench, fixture, stage, ms, items, stat_calls, allocs, bytes, ok });
+  }
+};
+
+
+// the formatter used before format_filesize(): long double division
+// and two vsnprintf() calls plus a malloc() per value
+static char *legacy_printf_alloc(const char *fmt, ...)
+{
+  char *buf;
+  va_list args, args2;
+
+  va_start(args, fmt);
+  va_copy(args2, args);
+  buf = static_cast<char *>(malloc(vsnprintf(nullptr, 0, fmt, args2) + 1));
+  va_end(args2);
+  vsprintf(buf, fmt, args);
+  va_end(args);
+
+  return buf;
+}
+
+static char *legacy_filesize(long bytes, bool iec)
+{
+  const char *label[] = {
+    "%ld bytes ", iec ? "%.1Lf kiB " : "%.1Lf kB ", iec ? "%.1Lf MiB " : "%.1Lf MB ",
+    iec ? "%.1Lf GiB " : "%.1Lf GB ", iec ? "%.1Lf TiB " : "%.1Lf TB "
+  };
+  const long base = iec ? 1024 : 1000;
+  long div = 1;
+  int idx = 0;
+
+  while (idx < 4 && bytes >= div * base) {
+    div *= base;
+    idx++;
+  }
+
+  if (idx == 0) return legacy_printf_alloc(label[0], bytes);
+
+  long double ld = bytes;
+  ld /= div;
+
+  return legacy_printf_alloc(label[idx], ld);
+}
+
+static void bench_filesize(fltk::filetable_ &table, size_t count)
+{
+  std::vector<long> values;
+  std::mt19937_64 rng(42);
+  char buf[64];
+  size_t sum = 0;
+
+  // mix of small, medium and large files
+  values.reserve(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    const long max[] = { 4096, 1L << 24, 1L << 34, 1L << 44 };
+    values.push_back(static_cast<long>(rng() % max[i % 4]));
+  }
+
+  for (const bool iec : { true, false }) {
+    const char *fixture = iec ? "iec" : "si";
+    long mismatch = 0;
+
+    // compare the output
+    for (const long v : values) {
+      char *p = legacy_filesize(v, iec);
+      table.format_filesize(buf, sizeof(buf), v, iec);
+      if (strcmp(p, buf) != 0) mismatch++;
+      free(p);
+    }
+
+    measure m_legacy;
+
+    for (const long v : values) {
+      char *p = legacy_filesize(v, iec);
+      sum += p[0];
+      free(p);
+    }
+
+    m_legacy.done("format", fixture, "printf_alloc", values.size());
+    measure m_new;
+
+    for (const long v : values) {
+      table.format_filesize(buf, sizeof(buf), v, iec);
+      sum += buf[0];
+    }
+
+    m_new.done("format", fixture, "format_filesize", values.size(), -1, mismatch == 0);
+  }
+
+  // prevent the loops from being optimized out
+  if (sum == 0) info(" ");
+}
+
+// simplify_directory_path() on paths with ".", ".." and double slashes
+static void bench_simplify_path(size_t count)
+{
+  const char *parts[] = { "usr", ".", "..", "share", "", "local", "lib", "..", "bin", "." };
+  std::vector<std::string> paths;
+  std::mt19937 rng(42);
+  size_t sum = 0;
+
+  count = count / 10 + 1;
+  paths.reserve(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    std::string s;
+    const int n = 2 + rng() % 10;
+
+    for (int j = 0; j < n; ++j) {
+      s.push_back('/');
+      s += parts[rng() % 10];
+    }
+    paths.push_back(s);
+  }
+
+  // spot check against a known result
+  const bool ok = (fltk::filetable_::simplify_directory_path("/usr/./share/..//lib/") == "/usr/lib");
+
+  measure m;
+
+  for (const auto &s : paths) {
+    sum += fltk::filetable_::simplify_directory_path(s).size();
+  }
+
+  m.done("path", "synthetic", "simplify_path", paths.size(), -1, ok);
+
+  if (sum == 0) info(" ");
+}
+
+// compare all alpha blending kernels against the scalar code and time them
+static void bench_blend(size_t count)
+{
+  const int W = 256, H = 256;
+  const size_t n = W * H;
+  std::vector<uint8_t> bg(n*4), fg(n*4), ref(n*4), out(n*4);
+  std::mt19937 rng(42);
+
+  for (size_t i = 0; i < n*4; ++i) {
+    bg[i] = rng();
+    fg[i] = rng();
+  }
+
+  // make sure the edge cases are covered
+  for (size_t i = 0; i < n; i += 3) {
+    fg[i*4 + 3] = (i % 2) ? 255 : 0;
+  }
+
+  const auto kernels = fltk::rgba_blend::kernels();
+  const uint8_t *layers[] = { fg.data(), bg.data(), fg.data() };
+  const size_t iterations = count / n + 1;
+
+  for (const auto &k : kernels) {
+    fltk::rgba_blend::blend(out.data(), bg.data(), layers, 3, W, H, 0, k.fn);
+
+    if (k.fn == fltk::rgba_blend::over_scalar) {
+      ref = out;
+    }
+
+    const bool exact = (memcmp(out.data(), ref.data(), n*4) == 0);
+    measure m;
+
+    for (size_t i = 0; i < iterations; ++i) {
+      k.fn(out.data(), fg.data(), n);
+    }
+
+    m.done("blend", "256x256", k.name, iterations * n, -1, exact);
+  }
+
+  info("blend kernel in use: %s\n", fltk::rgba_blend::kernel().name);
+}
+
+
+// synthetic directories
+
+static int remove_cb(const char *path, const struct stat *, int, struct FTW *) {
+  return remove(path);
+}
+
+static void remove_tree(const std::string &path) {
+  nftw(path.c_str(), remove_cb, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+static void touch_files(int fd, const char *fmt, long n)
+{
+  char buf[64];
+
+  for (long i = 0; i < n; ++i) {
+    snprintf(buf, sizeof(buf), fmt, i);
+    const int f = openat(fd, buf, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (f != -1) ::close(f);
+  }
+}
+
+// "files" empty files, 10 subdirectories and links to each of them
+// (the layout of make_huge_dir.sh)
+static bool make_flat(const std::string &path, long files)
+{
+  char buf[64];
+
+  if (mkdir(path.c_str(), 0755) == -1) return false;
+
+  const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) return false;
+
+  for (int i = 0; i < 10; ++i) {
+    char target[32];
+    snprintf(target, sizeof(target), "dir_%d", i);
+    snprintf(buf, sizeof(buf), "link_%d", i);
+    mkdirat(fd, target, 0755);
+    symlinkat(target, fd, buf);
+  }
+
+  touch_files(fd, "file_%07ld", files);
+  ::close(fd);
+
+  return true;
+}
+
+// "links" symbolic links: a third each to a directory, to a file
+// and to nothing
+static bool make_links(const std::string &path, long links)
+{
+  char buf[64];
+
+  if (mkdir(path.c_str(), 0755) == -1) return false;
+
+  const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) return false;
+
+  mkdirat(fd, "dir", 0755);
+  touch_files(fd, "file", 1);
+
+  for (long i = 0; i < links; ++i) {
+    const char *target[] = { "dir", "file", "missing" };
+    snprintf(buf, sizeof(buf), "link_%07ld", i);
+    symlinkat(target[i % 3], fd, buf);
+  }
+
+  ::close(fd);
+
+  return true;
+}
+
+// a chain of "depth" directories with 8 files on each level;
+// returns the path of the deepest one
+static std::string make_deep(const std::string &path, int depth)
+{
+  std::string s = path;
+
+  for (int i = 0; i < depth; ++i) {
+    if (i > 0) s += "/d";
+    if (mkdir(s.c_str(), 0755) == -1) return "";
+
+    const int fd = ::open(s.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return "";
+    touch_files(fd, "file_%ld", 8);
+    ::close(fd);
+  }
+
+  return s;
+}
+
+
+// the directory scan of fltk::dirtree before it trusted d_type:
+// lstat() on every entry and stat() on links
+static long legacy_count_subdirs(const char *path, size_t &nstat)
+{
+  DIR *d = opendir(path);
+  if (!d) return -1;
+
+  struct dirent *dir;
+  long n = 0;
+
+  while ((dir = readdir(d)) != NULL) {
+    struct stat st;
+
+    if (dir->d_name[0] == '.') continue;
+
+    nstat++;
+    if (fstatat(dirfd(d), dir->d_name, &st, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == -1) continue;
+
+    if (S_ISLNK(st.st_mode)) {
+      nstat++;
+      if (fstatat(dirfd(d), dir->d_name, &st, AT_NO_AUTOMOUNT) == -1) continue;
+    }
+
+    if (S_ISDIR(st.st_mode)) n++;
+  }
+
+  closedir(d);
+
+  return n;
+}
+
+// expose the sorting of the table
+class bench_table : public fltk::filetable_simple
+{
+public:
+  bench_table() : fltk::filetable_simple(0, 0, 640, 480) {}
+  using fltk::filetable_::sort_column;
+};
+
+// scan a flat directory with each mode of the scanner, the way the
+// tree did it before it trusted d_type, and with the widgets;
+// "subdirs" is the expected number of directories including links
+static void bench_scan(const std::string &path, const std::string &fixture, long entries,
+                       long subdirs, bool gui)
+{
+  const int modes[] = { fltk::dirscan::NAMES_ONLY, fltk::dirscan::DIRS_ONLY, fltk::dirscan::STAT };
+  const char *stages[] = { "scan_names", "scan_dirs", "scan_stat" };
+
+  for (int i = 0; i < 3; ++i) {
+    size_t nstat = 0;
+    long n = 0, dirs = 0;
+    measure m;
+
+    fltk::dirscan::scan(path.c_str(), false, modes[i], [&] (const fltk::dirscan::entry_t &e) {
+      n++;
+      if (e.is_dir) dirs++;
+    }, NULL, &nstat);
+
+    // d_type of links isn't followed without stat()
+    const bool ok = (modes[i] == fltk::dirscan::NAMES_ONLY) ? (n == entries)
+      : (modes[i] == fltk::dirscan::DIRS_ONLY) ? (n == subdirs) : (n == entries && dirs == subdirs);
+
+    m.done("scan", fixture, stages[i], n, nstat, ok);
+  }
+
+  { size_t nstat = 0;
+    measure m;
+    const long n = legacy_count_subdirs(path.c_str(), nstat);
+    m.done("scan", fixture, "scan_lstat_all", entries, nstat, n == subdirs);
+  }
+
+  { size_t nstat = 0;
+    measure m;
+    const long n = fltk::dirtree::count_subdirs(path.c_str(), false, &nstat);
+    m.done("scan", fixture, "tree_scan", n, nstat, n == subdirs);
+  }
+
+  if (!gui) return;
+
+  bench_table table;
+
+  { measure m;
+    const bool ok = table.load_dir(path.c_str());
+    m.done("table", fixture, "load_dir", static_cast<long>(table.entries()), -1, ok && static_cast<long>(table.entries()) == entries);
+  }
+
+  const int cols[] = { fltk::filetable_::COL_NAME, fltk::filetable_::COL_SIZE, fltk::filetable_::COL_LAST_MOD };
+  const char *sort_stages[] = { "sort_name", "sort_size", "sort_date" };
+
+  for (int i = 0; i < 3; ++i) {
+    measure m;
+    table.sort_column(cols[i]);
+    m.done("table", fixture, sort_stages[i], static_cast<long>(table.entries()));
+  }
+
+  { measure m;
+    const bool ok = table.refresh();
+    m.done("table", fixture, "refresh", static_cast<long>(table.entries()), -1, ok && static_cast<long>(table.entries()) == entries);
+  }
+
+  // replace a file and refresh, so that the row ids aren't dense
+  // anymore; every row must still be selectable
+  { const long expected = entries - (unlink((path + "/file_0000000").c_str()) == 0 ? 1 : 0) + 1;
+    const int f = ::open((path + "/file_new").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (f != -1) ::close(f);
+
+    table.multi_select(true);
+    measure m;
+    bool ok = table.refresh();
+    table.select_all();
+
+    for (size_t i = 0; i < table.entries(); ++i) {
+      if (!table.entry_selected(i)) ok = false;
+    }
+
+    ok = ok && table.selected_count() == table.entries() && static_cast<long>(table.entries()) == expected;
+    m.done("table", fixture, "select_all", static_cast<long>(table.entries()), -1, ok);
+  }
+}
+
+// walk down a deep chain of directories with the scanner and
+// open its deepest directory in a tree
+static void bench_deep(const std::string &path, const std::string &deepest, int depth, bool gui)
+{
+  const std::string fixture = "deep_" + std::to_string(depth);
+
+  { std::string s = path;
+    size_t nstat = 0;
+    long levels = 0;
+    measure m;
+
+    for (;;) {
+      long n = 0;
+      fltk::dirscan::scan(s.c_str(), false, fltk::dirscan::DIRS_ONLY,
+                          [&n] (const fltk::dirscan::entry_t &) { n++; }, NULL, &nstat);
+      levels++;
+      if (n == 0) break;
+      s += "/d";
+    }
+
+    m.done("scan", fixture, "walk_dirs", levels, nstat, levels == depth);
+  }
+
+  if (!gui) return;
+
+  fltk::dirtree tree(0, 0, 300, 480);
+
+  { measure m;
+    const bool ok = tree.load_dir(deepest.c_str());
+    m.done("tree", fixture, "load_dir", depth, -1, ok);
+  }
+
+  { measure m;
+    const bool ok = (tree.find_path(deepest.c_str()) != NULL);
+    m.done("tree", fixture, "find_path", 1, -1, ok);
+  }
+
+  tree.close_root();
+}
+
+static void bench_dirs(const char *base, bool huge, bool gui)
+{
+  std::string tmpl = std::string(base) + "/fltk_benchmark_XXXXXX";
+  const char *root = mkdtemp(&tmpl[0]);
+
+  if (!root) {
+    perror("mkdtemp()");
+    g_failed = true;
+    return;
+  }
+
+  std::vector<long> sizes = { 1000, 100000 };
+  if (huge) sizes.push_back(1000000);
+
+  for (const long files : sizes) {
+    const std::string fixture = "flat_" + std::to_string(files);
+    const std::string path = std::string(root) + "/" + fixture;
+    const long entries = files + 20;
+    measure m;
+    const bool ok = make_flat(path, files);
+    m.done("fixture", fixture, "create", entries, -1, ok);
+
+    if (ok) bench_scan(path, fixture, entries, 20, gui);
+    remove_tree(path);
+  }
+
+  { const long links = 30000;
+    const std::string fixture = "links_" + std::to_string(links);
+    const std::string path = std::string(root) + "/" + fixture;
+    const long entries = links + 2;
+    measure m;
+    const bool ok = make_links(path, links);
+    m.done("fixture", fixture, "create", entries, -1, ok);
+
+    if (ok) bench_scan(path, fixture, entries, links / 3 + 1, gui);
+    remove_tree(path);
+  }
+
+  { const int depth = 256;
+    const std::string path = std::string(root) + "/deep";
+    measure m;
+    const std::string deepest = make_deep(path, depth);
+    m.done("fixture", "deep_" + std::to_string(depth), "create", depth * 9, -1, !deepest.empty());
+
+    if (!deepest.empty()) bench_deep(path, deepest, depth, gui);
+    remove_tree(path);
+  }
+
+  rmdir(root);
+}
+
+
+int main(int argc, char **argv)
+{
+  size_t count = 10*1000*1000;
+  const char *dir = (access("/dev/shm", W_OK) == 0) ? "/dev/shm" : "/tmp";
+  bool huge = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0) {
+      g_json = true;
+    } else if (strcmp(argv[i], "--huge") == 0) {
+      huge = true;
+    } else if (strncmp(argv[i], "--dir=", 6) == 0) {
+      dir = argv[i] + 6;
+    } else {
+      count = strtoul(argv[i], NULL, 10);
+    }
+  }
+
+  // the widgets need fonts and therefore a display
+  const bool gui = (getenv("DISPLAY") != NULL);
+  if (!gui) info("$DISPLAY not set, skipping the table and tree stages\n");
+
+  fltk::filetable_simple table(0, 0, 400, 300);
+
+  bench_filesize(table, count);
+  bench_simplify_path(count);
+  bench_blend(count);
+  bench_dirs(dir, huge, gui);
+
+  return g_failed ? 1 : 0;
+}
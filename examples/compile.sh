@@ -30,6 +30,7 @@ g++ $fltk_cxxflags $cxxflags -o tree tree.cpp $fltk_ldflags $ldflags
 g++ $cxxflags print_xdg_dirs.cpp -o print_xdg_dirs $ldflags
 g++ $fltk_cxxflags $cxxflags -o listfiles_extension listfiles_extension.cpp $fltk_ldflags $ldflags
 g++ $fltk_cxxflags $cxxflags -o listfiles_simple listfiles_simple.cpp $fltk_ldflags $ldflags
+g++ $fltk_cxxflags $cxxflags -o benchmark benchmark.cpp $fltk_ldflags $ldflags
 
 g++ $fltk_cxxflags $cxxflags -DDLOPEN_MAGIC=1 -o listfiles_magic_dlopen listfiles_magic.cpp $fltk_ldflags $ldflags
 g++ $fltk_cxxflags $cxxflags -o fileselection fileselection.cpp $fltk_ldflags $ldflags -lmagic
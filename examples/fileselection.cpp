@@ -31,12 +31,18 @@
 
 int main()
 {
+  fltk::stats stats;
+  //stats.trace("fileselection_trace.json");  // open in chrome://tracing
+
   Fl_Double_Window win(800, 600, "Test");
 
   fltk::fileselection<fltk::filetable_simple> sel(4, 4, win.w() - 8, win.h() - 8);
   sel.load_default_icons();
   //sel.use_iec(false);
   //sel.show_hidden(true);
+  //sel.quick_open(true);
+  //sel.show_preview(true);
+  //sel.instrument(&stats);
   //sel.sort_mode(sel.sort_mode() | fltk::filetable_::SORT_DIRECTORY_AS_FILE);
   sel.load_dir("/usr/local");
 
@@ -49,5 +55,14 @@ int main()
   const char *p = sel.selection();
   if (p) printf("%s\n", p);
 
+  if (sel.instrument()) {
+    const fltk::stats::counters_t c = stats.total();
+
+    for (int i = 0; i < fltk::stats::STAGE_MAX; ++i) {
+      printf("%-12s %10.2f ms %8lu calls\n", fltk::stats::stage_name(i), c.ms[i], c.calls[i]);
+    }
+    printf("%lu entries, %lu stat calls, %ld bytes heap growth\n", c.entries, c.stat_calls, c.heap_growth);
+  }
+
   return rv;
 }
@@ -64,6 +64,10 @@ int main()
   table.labelsize(16);
   table.load_default_icons();
   //table.add_filter("sh");
+  //table.huge_mode(true);
+  //table.multi_select(true);
+  //table.thumbnails(true);
+  //table.grid_view(true);
 
   table.load_dir();
 
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Create a directory with a million empty files on a tmpfs, to test
+# the huge directory mode of the fltk::filetable_ subclasses:
+#
+#   ./make_huge_dir.sh [directory] [number of files]
+#
+# /dev/shm is a tmpfs on most Linux systems; remove the directory
+# with "rm -rf" when you're done.
+set -e
+
+dir="${1:-/dev/shm/fltk-huge-dir}"
+n="${2:-1000000}"
+
+mkdir -p "$dir"
+cd "$dir"
+
+# a few subdirectories and links in between the files
+for i in 1 2 3 4 5 6 7 8 9 10; do
+  mkdir -p "dir_$i"
+  ln -sf "dir_$i" "link_$i"
+done
+
+seq -f "file_%07g" 1 "$n" | xargs touch
+
+echo "$dir: $(ls -f "$dir" | wc -l) entries"
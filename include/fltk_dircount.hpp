@@ -0,0 +1,233 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef fltk_dircount_hpp
+#define fltk_dircount_hpp
+
+#include <FL/Fl.H>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <stdint.h>
+
+#include "fltk_dirscan.hpp"
+
+
+namespace fltk
+{
+
+// number of entries of directories, counted on a pool of worker
+// threads; used by the fltk::filetable_ subclasses in huge directory
+// mode, so that drawing a row never waits for a directory to be read;
+// all methods must be called from the main thread
+class dircount
+{
+public:
+  typedef struct {
+    uint32_t id;       // chosen by the caller, i.e. a row id
+    std::string path;
+  } job_t;
+
+  typedef struct {
+    uint32_t id;
+    long count;        // -1 on error
+  } result_t;
+
+  typedef void (*callback_t)(void *);
+
+private:
+  typedef struct {
+    job_t job;
+    unsigned gen;
+    bool hidden;
+  } queued_t;
+
+  // shared with the worker threads
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<queued_t> queue_;
+  std::vector<result_t> done_;
+  std::unordered_set<uint32_t> pending_;  // queued or in progress
+  unsigned gen_ = 0;
+  bool stop_ = false;
+
+  std::vector<std::thread> workers_;
+
+  // main thread only
+  bool polling_ = false;
+  callback_t cb_ = NULL;
+  void *cb_data_ = NULL;
+
+#define POLL_INTERVAL 0.05
+
+  void worker()
+  {
+    for (;;) {
+      queued_t q;
+      long count = 0;
+
+      { std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_) return;
+        q = queue_.front();
+        queue_.pop_front();
+      }
+
+      auto sink = [&count] (const dirscan::entry_t &) { count++; };
+
+      if (!dirscan::scan(q.job.path.c_str(), q.hidden, dirscan::NAMES_ONLY, sink)) {
+        count = -1;
+      }
+
+      { std::lock_guard<std::mutex> lock(mtx_);
+
+        // skip the results of jobs from before clear()
+        if (q.gen == gen_) {
+          done_.push_back({ q.job.id, count });
+          pending_.erase(q.job.id);
+        }
+      }
+    }
+  }
+
+  // hand finished counts to the callback
+  static void poll_cb(void *v)
+  {
+    dircount *o = static_cast<dircount *>(v);
+    bool done, busy;
+
+    { std::lock_guard<std::mutex> lock(o->mtx_);
+      done = !o->done_.empty();
+      busy = !o->pending_.empty();
+    }
+
+    if (done && o->cb_) {
+      o->cb_(o->cb_data_);
+    }
+
+    if (busy) {
+      Fl::repeat_timeout(POLL_INTERVAL, poll_cb, v);
+    } else {
+      o->polling_ = false;
+    }
+  }
+
+public:
+  // c'tor; "threads" is the number of worker threads (0 = up to 4)
+  dircount(unsigned threads=0)
+  {
+    if (threads == 0) {
+      threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    }
+
+    for (unsigned i = 0; i < threads; ++i) {
+      workers_.emplace_back(&dircount::worker, this);
+    }
+  }
+
+  // d'tor
+  virtual ~dircount()
+  {
+    { std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+      queue_.clear();
+    }
+
+    cv_.notify_all();
+
+    for (auto &t : workers_) {
+      if (t.joinable()) t.join();
+    }
+
+    Fl::remove_timeout(poll_cb, this);
+  }
+
+  // these directories are wanted now, i.e. the visible ones; anything
+  // that was requested earlier but wasn't started yet is dropped
+  void request(const std::vector<job_t> &jobs, bool hidden)
+  {
+    bool queued = false;
+
+    { std::lock_guard<std::mutex> lock(mtx_);
+
+      for (const auto &q : queue_) {
+        pending_.erase(q.job.id);
+      }
+
+      queue_.clear();
+
+      for (const auto &j : jobs) {
+        if (pending_.insert(j.id).second) {
+          queue_.push_back({ j, gen_, hidden });
+          queued = true;
+        }
+      }
+    }
+
+    if (!queued) return;
+
+    cv_.notify_all();
+
+    if (!polling_) {
+      polling_ = true;
+      Fl::add_timeout(POLL_INTERVAL, poll_cb, this);
+    }
+  }
+
+  // get the counts that were finished since the last call
+  void take(std::vector<result_t> &vec)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    vec.clear();
+    vec.swap(done_);
+  }
+
+  // drop all requests and results, i.e. because the ids aren't valid
+  // anymore; counts that are in progress are thrown away
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    gen_++;
+    queue_.clear();
+    pending_.clear();
+    done_.clear();
+  }
+
+  // called from the main thread whenever new counts are ready
+  void callback(callback_t cb, void *data) {
+    cb_ = cb;
+    cb_data_ = data;
+  }
+
+#undef POLL_INTERVAL
+};
+
+} // namespace fltk
+
+#endif  // fltk_dircount_hpp
@@ -0,0 +1,230 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef fltk_dirscan_hpp
+#define fltk_dirscan_hpp
+
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+namespace fltk
+{
+
+// directory enumeration shared by the widgets; it doesn't depend on
+// FLTK, so it can be used and tested without a display
+//
+// the entries are handed to a "sink", any callable that takes a
+// "const dirscan::entry_t &"; "." and ".." are never reported
+class dirscan
+{
+  // adds the milliseconds from its creation to "ms" if that isn't NULL
+  class stat_timer
+  {
+    double *ms_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    stat_timer(double *ms) : ms_(ms) {
+      if (ms_) start_ = std::chrono::steady_clock::now();
+    }
+
+    ~stat_timer() {
+      if (ms_) {
+        *ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+      }
+    }
+  };
+
+public:
+  enum {
+    NAMES_ONLY,   // no stat() calls; "st" is always NULL and the
+                  // type is taken from d_type
+    DIRS_ONLY,    // only directories and links to directories; d_type is
+                  // trusted and only links and DT_UNKNOWN entries are stat()ed
+    STAT,         // stat() every entry, following links unless they're dead
+    STAT_NOFOLLOW // stat() every entry without following links
+  };
+
+  typedef struct {
+    const char *name;
+    const struct stat *st;  // NULL if not requested or if stat() failed
+    bool is_dir;            // links to directories included
+    bool is_link;
+  } entry_t;
+
+  // stat() an entry of the directory "fd"; symbolic links are followed
+  // if "follow" is true, unless they're dead; "is_link" is set if the
+  // entry itself is a symbolic link
+  static bool stat_entry(int fd, const char *name, struct stat &st, bool &is_link, bool follow=true)
+  {
+    struct stat lst;
+
+    if (follow && fstatat(fd, name, &st, AT_NO_AUTOMOUNT) == 0) {
+      is_link = (fstatat(fd, name, &lst, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == 0
+                 && S_ISLNK(lst.st_mode));
+      return true;
+    }
+
+    // don't follow link in case of dead link
+    if (fstatat(fd, name, &st, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == -1) {
+      return false;
+    }
+
+    is_link = S_ISLNK(st.st_mode);
+    return true;
+  }
+
+  // fill in the type of an entry; returns false if it's skipped
+  static bool get_type(int fd, const struct dirent *dir, int mode, struct stat &st,
+                       entry_t &e, size_t *nstat)
+  {
+    const char *name = dir->d_name;
+
+    switch (mode) {
+      case NAMES_ONLY:
+        e.is_dir = (dir->d_type == DT_DIR);
+        e.is_link = (dir->d_type == DT_LNK);
+        return true;
+
+      case DIRS_ONLY:
+        if (dir->d_type == DT_DIR) {
+          e.is_dir = true;
+          return true;
+        }
+
+        if (dir->d_type == DT_UNKNOWN) {
+          // act like lstat()
+          if (nstat) (*nstat)++;
+          if (fstatat(fd, name, &st, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == -1) return false;
+          e.is_link = S_ISLNK(st.st_mode);
+        } else if (dir->d_type == DT_LNK) {
+          e.is_link = true;
+        } else {
+          return false;
+        }
+
+        // act like stat()
+        if (e.is_link) {
+          if (nstat) (*nstat)++;
+          if (fstatat(fd, name, &st, AT_NO_AUTOMOUNT) == -1) return false;
+        }
+
+        e.is_dir = S_ISDIR(st.st_mode);
+        return e.is_dir;
+
+      default:
+        if (nstat) *nstat += (mode == STAT) ? 2 : 1;
+
+        if (stat_entry(fd, name, st, e.is_link, mode == STAT)) {
+          e.st = &st;
+          e.is_dir = S_ISDIR(st.st_mode);
+        }
+        return true;
+    }
+  }
+
+  // read the directory "fd", which is closed afterwards; returns false
+  // if it can't be read; stops early if "cancel" is set; "nstat" is
+  // increased by the number of stat() calls and "stat_ms" by the
+  // milliseconds spent in them
+  template<class Sink>
+  static bool scan(int fd, bool hidden, int mode, Sink &&sink,
+                   const std::atomic<bool> *cancel=NULL, size_t *nstat=NULL,
+                   double *stat_ms=NULL)
+  {
+    struct dirent *dir;
+    DIR *d;
+
+    if (fd == -1) {
+      return false;
+    }
+
+    if ((d = fdopendir(fd)) == NULL) {
+      ::close(fd);
+      return false;
+    }
+
+    for (;;) {
+      // readdir() only sets errno on errors
+      errno = 0;
+      if ((dir = readdir(d)) == NULL) break;
+
+      const char *name = dir->d_name;
+      struct stat st;
+      entry_t e = { name, NULL, false, false };
+
+      if (cancel && *cancel) {
+        break;
+      }
+
+      // handle hidden files
+      if (!hidden && name[0] == '.') {
+        continue;
+      }
+
+      // no "." and ".." entries
+      if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+        continue;
+      }
+
+      bool keep;
+
+      // the timer stops before the sink is called
+      { stat_timer timer(mode == NAMES_ONLY ? NULL : stat_ms);
+        keep = get_type(fd, dir, mode, st, e, nstat);
+      }
+
+      if (!keep) continue;
+
+      sink(e);
+    }
+
+    const int errsv = errno;
+    closedir(d);
+
+    return (errsv == 0);
+  }
+
+  // same as above for a path
+  template<class Sink>
+  static bool scan(const char *path, bool hidden, int mode, Sink &&sink,
+                   const std::atomic<bool> *cancel=NULL, size_t *nstat=NULL,
+                   double *stat_ms=NULL)
+  {
+    const int fd = ::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return scan(fd, hidden, mode, sink, cancel, nstat, stat_ms);
+  }
+};
+
+} // namespace fltk
+
+#endif  // fltk_dirscan_hpp
@@ -0,0 +1,431 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef fltk_dirsize_hpp
+#define fltk_dirsize_hpp
+
+#include <FL/Fl.H>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "fltk_dirscan.hpp"
+
+
+namespace fltk
+{
+
+// recursive disk usage of directories, walked on a pool of worker
+// threads; like du(1) the totals include the directories themselves
+// and files with several hard links are counted once per walk;
+// the totals of all subdirectories are cached together with their
+// mtime and reused by later walks as long as the mtime didn't change;
+// each directory is opened by its full path when its job starts
+// (keeping the parent's fd open until then could use up the fds on
+// wide trees) and its entries are stat()ed relative to that fd;
+// all methods must be called from the main thread
+class dirsize
+{
+public:
+  typedef struct {
+    long bytes;  // disk usage so far or in total; -1 on error
+    long files;  // number of files and directories
+    bool done;
+  } result_t;
+
+  typedef void (*callback_t)(void *);
+
+private:
+  enum {
+    CACHE_MAX = 100000  // cached directories
+  };
+
+  enum : size_t {
+    NODE_NONE = static_cast<size_t>(-1)
+  };
+
+  // a directory of a running walk
+  typedef struct {
+    std::string path;
+    long mtime;
+    size_t parent;    // NODE_NONE for the requested directory
+    size_t root;      // index of the requested directory
+    long bytes;       // itself, own entries and finished subdirectories
+    long files;
+    long progress;    // root only: bytes found so far
+    int pending;      // unfinished scans of this subtree
+    bool error;
+    bool links;       // subtree has files with several hard links
+  } node_t;
+
+  typedef struct {
+    size_t node;
+    unsigned gen;
+  } job_t;
+
+  // totals of subtrees with hard links depend on what else the walk
+  // has seen, so they're only cached for the requested directory and
+  // never folded into another walk
+  typedef struct {
+    long mtime;
+    long bytes;
+    long files;
+    bool links;
+  } cached_t;
+
+  typedef struct {
+    std::string name;
+    long mtime;
+    long bytes;  // the directory itself
+  } subdir_t;
+
+  typedef struct {
+    dev_t dev;
+    ino_t ino;
+  } inode_t;
+
+  struct inode_hash {
+    size_t operator()(const inode_t &i) const {
+      return std::hash<uint64_t>()(static_cast<uint64_t>(i.ino) ^ (static_cast<uint64_t>(i.dev) << 40));
+    }
+  };
+
+  struct inode_equal {
+    bool operator()(const inode_t &a, const inode_t &b) const {
+      return (a.ino == b.ino && a.dev == b.dev);
+    }
+  };
+
+  // results of reading a single directory
+  typedef struct {
+    long bytes;
+    long files;
+    std::vector<subdir_t> dirs;
+    std::vector<std::pair<inode_t, long>> links;  // files with hard links
+  } scan_t;
+
+  // shared with the worker threads
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<job_t> queue_;
+  std::deque<node_t> nodes_;  // cleared whenever no walk is running
+  std::unordered_map<std::string, size_t> roots_;  // running walks
+  std::unordered_map<std::string, cached_t> cache_;
+  // hard links seen by each running walk, by root node
+  std::unordered_map<size_t, std::unordered_set<inode_t, inode_hash, inode_equal>> seen_;
+  unsigned gen_ = 0;
+  int active_ = 0;
+  bool changed_ = false;
+  bool stop_ = false;
+
+  std::vector<std::thread> workers_;
+
+  // main thread only
+  bool polling_ = false;
+  callback_t cb_ = NULL;
+  void *cb_data_ = NULL;
+
+#define POLL_INTERVAL 0.1
+
+  // read a directory without holding the lock; the blocks of the
+  // directory itself are only added for the requested directory,
+  // subdirectories were already accounted by their parent
+  static bool scan(const std::string &path, bool root, scan_t &s)
+  {
+    auto sink = [&s] (const dirscan::entry_t &e) {
+      if (!e.st) return;
+
+      const struct stat &st = *e.st;
+      const long bytes = static_cast<long>(st.st_blocks) * 512;
+      s.files++;
+
+      if (S_ISDIR(st.st_mode)) {
+        s.dirs.push_back({ e.name, static_cast<long>(st.st_mtime), bytes });
+      } else if (st.st_nlink > 1) {
+        s.links.push_back({ { st.st_dev, st.st_ino }, bytes });
+      } else {
+        s.bytes += bytes;
+      }
+    };
+
+    const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct stat st;
+
+    if (root && fd != -1 && fstat(fd, &st) == 0) {
+      s.bytes += static_cast<long>(st.st_blocks) * 512;
+    }
+
+    return dirscan::scan(fd, true, dirscan::STAT_NOFOLLOW, sink);
+  }
+
+  // a scan of node "idx" has finished; hand finished subtrees up to
+  // their parents and cache them
+  void finish(size_t idx, long bytes, long files)
+  {
+    node_t *n = &nodes_[idx];
+    n->bytes += bytes;
+    n->files += files;
+    nodes_[n->root].progress += bytes;
+    changed_ = true;
+
+    while (--n->pending == 0) {
+      if (n->parent == NODE_NONE || !n->links) {
+        if (cache_.size() >= CACHE_MAX) cache_.clear();
+        cache_[n->path] = { n->mtime, n->error ? -1 : n->bytes, n->files, n->links };
+      }
+
+      if (n->parent == NODE_NONE) {
+        roots_.erase(n->path);
+        seen_.erase(n->root);
+        break;
+      }
+
+      node_t *p = &nodes_[n->parent];
+      p->bytes += n->bytes;
+      p->files += n->files;
+      p->links |= n->links;
+      n = p;
+    }
+  }
+
+  void worker()
+  {
+    for (;;) {
+      job_t job;
+      std::string path;
+      bool root;
+      scan_t s = { 0, 0, {}, {} };
+
+      { std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_) return;
+        job = queue_.front();
+        queue_.pop_front();
+        path = nodes_[job.node].path;
+        root = (nodes_[job.node].parent == NODE_NONE);
+        active_++;
+      }
+
+      const bool ok = scan(path, root, s);
+      bool queued = false;
+
+      { std::lock_guard<std::mutex> lock(mtx_);
+        active_--;
+
+        // skip the results of a cancelled walk
+        if (job.gen == gen_) {
+          node_t &n = nodes_[job.node];
+          if (!ok && n.parent == NODE_NONE) n.error = true;
+
+          auto &seen = seen_[n.root];
+          if (!s.links.empty()) n.links = true;
+
+          for (const auto &l : s.links) {
+            if (seen.insert(l.first).second) s.bytes += l.second;
+          }
+
+          for (const auto &d : s.dirs) {
+            std::string sub = path;
+            if (sub.back() != '/') sub.push_back('/');
+            sub += d.name;
+
+            // unchanged subtrees are taken from the cache
+            auto it = cache_.find(sub);
+
+            if (it != cache_.end() && it->second.mtime == d.mtime && it->second.bytes >= 0 && !it->second.links) {
+              s.bytes += it->second.bytes;
+              s.files += it->second.files;
+              continue;
+            }
+
+            // the subdirectory's own blocks are part of its total
+            nodes_[n.root].progress += d.bytes;
+            nodes_.push_back({ sub, d.mtime, job.node, n.root, d.bytes, 0, 0, 1, false, false });
+            queue_.push_back({ nodes_.size() - 1, gen_ });
+            n.pending++;
+            queued = true;
+          }
+
+          finish(job.node, s.bytes, s.files);
+        }
+
+        if (active_ == 0 && queue_.empty()) {
+          nodes_.clear();
+          seen_.clear();
+        }
+      }
+
+      if (queued) cv_.notify_all();
+    }
+  }
+
+  // report progress and finished walks
+  static void poll_cb(void *v)
+  {
+    dirsize *o = static_cast<dirsize *>(v);
+    bool changed, busy;
+
+    { std::lock_guard<std::mutex> lock(o->mtx_);
+      changed = o->changed_;
+      o->changed_ = false;
+      busy = !o->roots_.empty();
+    }
+
+    if (changed && o->cb_) {
+      o->cb_(o->cb_data_);
+    }
+
+    if (busy) {
+      Fl::repeat_timeout(POLL_INTERVAL, poll_cb, v);
+    } else {
+      o->polling_ = false;
+    }
+  }
+
+public:
+  // c'tor; "threads" is the number of worker threads (0 = up to 4)
+  dirsize(unsigned threads=0)
+  {
+    if (threads == 0) {
+      threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    }
+
+    for (unsigned i = 0; i < threads; ++i) {
+      workers_.emplace_back(&dirsize::worker, this);
+    }
+  }
+
+  // d'tor
+  virtual ~dirsize()
+  {
+    { std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+      queue_.clear();
+    }
+
+    cv_.notify_all();
+
+    for (auto &t : workers_) {
+      if (t.joinable()) t.join();
+    }
+
+    Fl::remove_timeout(poll_cb, this);
+  }
+
+  // start a walk of "path" unless it's already running or
+  // a result for this mtime is cached
+  void request(const std::string &path, long mtime)
+  {
+    if (path.empty()) return;
+
+    { std::lock_guard<std::mutex> lock(mtx_);
+      auto it = cache_.find(path);
+
+      if (roots_.count(path) > 0 || (it != cache_.end() && it->second.mtime == mtime)) {
+        return;
+      }
+
+      nodes_.push_back({ path, mtime, NODE_NONE, nodes_.size(), 0, 0, 0, 1, false, false });
+      roots_[path] = nodes_.size() - 1;
+      queue_.push_back({ nodes_.size() - 1, gen_ });
+    }
+
+    cv_.notify_all();
+
+    if (!polling_) {
+      polling_ = true;
+      Fl::add_timeout(POLL_INTERVAL, poll_cb, this);
+    }
+  }
+
+  // get the progress or the result of a walk;
+  // returns false if "path" was never requested
+  bool get(const std::string &path, long mtime, result_t &r)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    auto root = roots_.find(path);
+
+    if (root != roots_.end()) {
+      const node_t &n = nodes_[root->second];
+      r = { n.progress, n.files, false };
+      return true;
+    }
+
+    auto it = cache_.find(path);
+
+    if (it != cache_.end() && it->second.mtime == mtime) {
+      r = { it->second.bytes, it->second.files, true };
+      return true;
+    }
+
+    return false;
+  }
+
+  // stop all walks; subtrees that were finished stay cached
+  void cancel()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    gen_++;
+    queue_.clear();
+    roots_.clear();
+
+    if (active_ == 0) {
+      nodes_.clear();
+      seen_.clear();
+    }
+  }
+
+  bool busy()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return !roots_.empty();
+  }
+
+  // called from the main thread while walks are making progress
+  void callback(callback_t cb, void *data) {
+    cb_ = cb;
+    cb_data_ = data;
+  }
+
+#undef POLL_INTERVAL
+};
+
+} // namespace fltk
+
+#endif  // fltk_dirsize_hpp
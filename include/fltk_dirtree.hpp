@@ -32,6 +32,13 @@
 #include <FL/Fl_Tree_Item.H>
 #include <FL/Fl_SVG_Image.H>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <ctype.h>
@@ -40,10 +47,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#endif
 
+#include "fltk_dirscan.hpp"
 #include "fltk_filetable_.hpp"
+#include "fltk_stats.hpp"
 
 
 namespace fltk
@@ -85,6 +100,19 @@ private:
     RGB_NUM = 3
   };
 
+  enum {
+    INSERT_BATCH = 256,  // children inserted per timeout of an async scan
+    PREFETCH_MAX = 512   // prefetched directories kept in memory
+  };
+
+  // a directory whose children are in the tree
+  typedef struct {
+    long mtime;
+    uint settings;      // see settings()
+    unsigned long used;  // for LRU eviction
+    unsigned style;     // style_gen_ when the children were styled
+  } loaded_t;
+
   typedef struct {
     char *name;
     bool is_link;
@@ -136,14 +164,74 @@ private:
   };
 
   std::string callback_item_path_;
+  std::unordered_map<std::string, Fl_Tree_Item *> index_;  // absolute path -> item
+  std::unordered_map<Fl_Tree_Item *, loaded_t> loaded_;    // retained subtrees only
+  unsigned long tick_ = 0;
+  stats *stats_ = NULL;  // instrumentation, see fltk::stats
+  unsigned style_gen_ = 0;  // increased by every update_items()
+  bool retain_ = false;
+  size_t retain_max_ = 200000;  // items kept in the tree
   bool show_hidden_ = false;
   bool sort_reverse_ = false;
   uint sort_mode_ = SORT_NUMERIC|SORT_IGNORE_CASE|SORT_IGNORE_LEADING_DOT;
 
   Fl_RGB_Image *rgb_[RGB_NUM] = {0};
-  Fl_SVG_Image *def_[ICN_NUM] = {0};
+  Fl_SVG_Image *def_[ICN_NUM] = {0};  // owned by icon_cache
+  Fl_SVG_Image *user_[ICN_NUM] = {0};  // as set, never resized
   Fl_SVG_Image *icn_[ICN_NUM] = {0};
 
+  // resized copies of user_; items that aren't restyled yet may
+  // still use older ones, so they're kept until the d'tor
+  std::vector<Fl_SVG_Image *> copies_;
+
+  // a directory opened by a click, read on its own thread; the
+  // entries are inserted in batches once the thread is done
+  typedef struct {
+    Fl_Tree_Item *ti;
+    Fl_Tree_Item *loading;  // placeholder child
+    std::string path;
+    std::thread th;
+    std::atomic<bool> cancel;
+    std::atomic<bool> done;
+    bool ok;
+    long mtime;
+    std::vector<dir_entry_t> list;  // sorted
+    size_t inserted;
+  } scan_job_t;
+
+  std::list<scan_job_t *> jobs_;
+  std::list<scan_job_t *> cancelled_;  // threads to join once they're done
+  bool async_ = true;
+  bool polling_ = false;
+  int sync_open_ = 0;  // > 0 while a path is opened by load_dir()
+
+  // a directory read ahead by the prefetcher
+  typedef struct {
+    long mtime;
+    bool hidden;
+    uint sort_mode;
+    bool sort_reverse;
+    std::vector<dir_entry_t> list;  // sorted
+    std::list<std::string>::iterator lru;
+  } prefetched_t;
+
+  // shared with the prefetch thread
+  std::mutex pf_mtx_;
+  std::condition_variable pf_cv_;
+  std::deque<std::string> pf_queue_;
+  std::unordered_map<std::string, prefetched_t> pf_cache_;
+  std::list<std::string> pf_lru_;  // most recently read first
+  bool pf_hidden_ = false;
+  uint pf_sort_mode_ = 0;
+  bool pf_sort_reverse_ = false;
+  bool pf_network_ = false;
+  bool pf_stop_ = false;
+
+  std::thread pf_thread_;
+  bool prefetch_ = true;
+  bool prefetch_network_ = false;
+  int prefetch_budget_ = 32;  // directories read ahead per expanded item
+
   static void default_callback(Fl_Widget *w, void *)
   {
     dirtree *o = static_cast<dirtree *>(w);
@@ -168,20 +256,45 @@ private:
     }
   }
 
-  static inline bool same_image_format(Fl_RGB_Image *a, Fl_RGB_Image *b)
+  static const char *default_icon_data(int idx)
   {
-    return (a && b && !a->fail() && !b->fail() &&
-            a->w() == b->w() && a->h() == b->h() &&
-            a->d() == b->d() && a->ld() == b->ld());
+    switch (idx) {
+      case ICN_DIR:
+        return FOLDER_GENERIC_SVG_DATA;
+      case ICN_LNK:
+        return OVERLAY_LINK_BIG_SVG_DATA;
+      case ICN_LCK:
+        return OVERLAY_PADLOCK_BIG_SVG_DATA;
+      default:
+        break;
+    }
+    return NULL;
   }
 
   // set icon by index number
   void usericon(Fl_SVG_Image *svg, int idx)
   {
     if (!svg || svg->fail()) return;
-    svg->proportional = false;
-    svg->resize(item_labelsize(), item_labelsize());
-    icn_[idx] = svg;
+
+    const int sz = item_labelsize();
+    Fl_SVG_Image *img = svg;
+
+    // the image may be shared (i.e. by icon_cache), so
+    // it's never resized; use a copy of the right size
+    if (svg->w() != sz || svg->h() != sz) {
+      img = static_cast<Fl_SVG_Image *>(svg->copy(sz, sz));
+
+      if (!img || img->fail()) {
+        if (img) delete img;
+        return;
+      }
+
+      img->proportional = false;
+      copies_.push_back(img);
+    }
+
+    user_[idx] = svg;
+    icn_[idx] = img;
 
     // it's important to set this here
     if (idx == ICN_DIR) Fl_Tree::usericon(icn_[idx]);
@@ -189,151 +302,154 @@ private:
 
 protected:
   // blend/overlay up to 3 Fl_RGB_Image* images in RGBA format
-  static Fl_RGB_Image *blend_rgba(Fl_RGB_Image *inBg, Fl_RGB_Image *inFg, Fl_RGB_Image *inFg2=NULL)
+  static Fl_RGB_Image *blend_rgba(Fl_RGB_Image *inBg, Fl_RGB_Image *inFg, Fl_RGB_Image *inFg2=NULL) {
+    return filetable_::blend_rgba(inBg, inFg, inFg2);
+  }
+
+  // return the absolute path of an item, ignoring empty labels
+  std::string item_path(const Fl_Tree_Item *ti)
   {
-    // background image is needed
-    if (!inBg || inBg->fail()) {
-      return NULL;
+    if (ti && ti->is_root()) {
+      return "/";
     }
 
-    if (!inFg || inFg->fail()) {
-      if (inFg2 && !inFg2->fail()) {
-        // take over pointer
-        inFg = inFg2;
-        inFg2 = NULL;
-      } else {
-        // no foreground images provided
-        return NULL;
+    std::vector<const char *> labels;
+    size_t len = 0;
+
+    for ( ; ti && !ti->is_root(); ti = ti->parent()) {
+      const char *l = ti->label();
+
+      if (l && *l) {
+        labels.push_back(l);
+        len += strlen(l) + 1;
       }
     }
 
-    const int w = inBg->w();
-    int ld = inBg->ld();
+    std::string s;
+    s.reserve(len);
 
-    // d() must be 4, ld() must be formatted correctly
-    if (inBg->d() != 4 || (ld > 0 && ld < w*4) || ld < 0) {
-      return NULL;
+    for (auto it = labels.rbegin(); it != labels.rend(); ++it) {
+      s.push_back('/');
+      s += *it;
     }
 
-    // compare image specs
+    return s;
+  }
 
-    if (!same_image_format(inBg, inFg)) {
-      return NULL;
+  // remove the children of "ti" and everything below them
+  // from the index; "path" is the path of "ti"
+  void unindex_children(Fl_Tree_Item *ti, std::string &path)
+  {
+    const size_t len = path.size();
+
+    for (int i = 0; i < ti->children(); ++i) {
+      Fl_Tree_Item *child = ti->child(i);
+      const char *l = child->label();
+
+      if (!l || !*l) continue;
+
+      if (path.back() != '/') path.push_back('/');
+      path += l;
+      index_.erase(path);
+      loaded_.erase(child);
+      unindex_children(child, path);
+      path.resize(len);
     }
+  }
 
-    if (!same_image_format(inFg, inFg2)) {
-      inFg2 = NULL;
-    }
-
-    // don't calculate with the full line data
-    if (ld != 0) {
-      ld -= w*4;
-    }
-
-    const int h = inBg->h();
-    uchar *out = new uchar[w*h*4];
-
-    // http://de.voidcc.com/question/p-shsavrtq-bz.html
-    if (inFg2) {
-      for (int x=0, i=0; x < w; ++x) {
-        for (int y=0; y < h; ++y, i+=4) {
-          const int off = i + y*ld;
-          const uchar *bg = inBg->array + off;
-          const uchar *fg = inFg->array + off;
-          const uchar *fg2 = inFg2->array + off;
-          uint alpha = fg[3] + 1;
-          uchar *px = out + i;
-
-          if (alpha == 1) {
-            px[0] = bg[0];
-            px[1] = bg[1];
-            px[2] = bg[2];
-            px[3] = bg[3];
-          } else {
-            const uint inv_alpha = 256 - fg[3];
-            px[0] = (alpha * fg[0] + inv_alpha * bg[0]) >> 8;
-            px[1] = (alpha * fg[1] + inv_alpha * bg[1]) >> 8;
-            px[2] = (alpha * fg[2] + inv_alpha * bg[2]) >> 8;
-            px[3] = (alpha * fg[3] + inv_alpha * bg[3]) >> 8;
-          }
-
-          if ((alpha = fg2[3] + 1) != 1) {
-            const uint inv_alpha = 256 - fg2[3];
-            px[0] = (alpha * fg2[0] + inv_alpha * px[0]) >> 8;
-            px[1] = (alpha * fg2[1] + inv_alpha * px[1]) >> 8;
-            px[2] = (alpha * fg2[2] + inv_alpha * px[2]) >> 8;
-            px[3] = (alpha * fg2[3] + inv_alpha * px[3]) >> 8;
-          }
-        }
-      }
-    } else {
-      for (int x=0, i=0; x < w; ++x) {
-        for (int y=0; y < h; ++y, i+=4) {
-          const int off = i + y*ld;
-          const uchar *bg = inBg->array + off;
-          const uchar *fg = inFg->array + off;
-          const uint alpha = fg[3] + 1;
-          uchar *px = out + i;
-
-          if (alpha == 1) {
-            px[0] = bg[0];
-            px[1] = bg[1];
-            px[2] = bg[2];
-            px[3] = bg[3];
-          } else {
-            const uint inv_alpha = 256 - fg[3];
-            px[0] = (alpha * fg[0] + inv_alpha * bg[0]) >> 8;
-            px[1] = (alpha * fg[1] + inv_alpha * bg[1]) >> 8;
-            px[2] = (alpha * fg[2] + inv_alpha * bg[2]) >> 8;
-            px[3] = (alpha * fg[3] + inv_alpha * bg[3]) >> 8;
-          }
-        }
-      }
+  // use this instead of Fl_Tree_Item::clear_children()
+  // to keep the index up to date
+  void clear_items(Fl_Tree_Item *ti)
+  {
+    if (!index_.empty() && ti->has_children()) {
+      std::string path = item_path(ti);
+      unindex_children(ti, path);
     }
 
-    Fl_RGB_Image *rgba = new Fl_RGB_Image(out, w, h, 4);
-    rgba->alloc_array = 1;
+    loaded_.erase(ti);
+    ti->clear_children();
+  }
 
-    return rgba;
+  // the settings that change the children of an item
+  uint settings() const {
+    return sort_mode_ | (sort_reverse_ ? 1u << 30 : 0) | (show_hidden_ ? 1u << 31 : 0);
   }
 
-  // return the absolute path of an item, ignoring empty labels
-  std::string item_path(const Fl_Tree_Item *ti)
+  static long dir_mtime(const std::string &path)
   {
-    if (ti->is_root()) {
-      return "/";
+    struct stat st;
+    return (stat(path.c_str(), &st) == 0) ? static_cast<long>(st.st_mtime) : -1;
+  }
+
+  // remember that the children of "ti" were read at "mtime"
+  void mark_loaded(Fl_Tree_Item *ti, long mtime)
+  {
+    if (retain_ && mtime != -1 && ti->has_children()) {
+      loaded_[ti] = { mtime, settings(), ++tick_, style_gen_ };
     }
+  }
 
-    std::string s;
+  // true if the retained children of "ti" and of its open
+  // subdirectories are still up to date; outdated open
+  // subdirectories are read again
+  bool revalidate(Fl_Tree_Item *ti)
+  {
+    auto it = loaded_.find(ti);
 
-    while (ti && !ti->is_root()) {
-      const char *l = ti->label();
+    if (it == loaded_.end() || it->second.settings != settings() ||
+        it->second.mtime != dir_mtime(item_path(ti)))
+    {
+      return false;
+    }
 
-      if (l && *l) {
-        s.insert(0, l);
-        s.insert(0, 1, '/');
+    it->second.used = ++tick_;
+
+    if (it->second.style != style_gen_) {
+      restyle_children(ti);
+    }
+
+    for (int i = 0; i < ti->children(); ++i) {
+      Fl_Tree_Item *child = ti->child(i);
+
+      if (!child->is_open() || !child->has_children() || revalidate(child)) {
+        continue;
+      }
+
+      if (async_ && sync_open_ == 0) {
+        start_scan(child);
+      } else if (!load_tree(child)) {
+        mark_locked(child);
       }
-      ti = ti->parent();
     }
 
-    return s;
+    return true;
   }
 
-  // update all items
-  void update_items(Fl_Tree_Item *ti)
+  // drop the least recently used collapsed subtrees while there are
+  // more than retain_max_ items in the tree
+  void trim_retained()
   {
-    if (!ti || ti->is_close()) {
-      return;
-    }
+    while (index_.size() > retain_max_) {
+      Fl_Tree_Item *lru = NULL;
+      unsigned long used = 0;
+
+      for (const auto &e : loaded_) {
+        if (e.first->is_close() && (!lru || e.second.used < used)) {
+          lru = e.first;
+          used = e.second.used;
+        }
+      }
 
-    if (ti == root()) {
-      ti->labelsize(item_labelsize());
-      ti->labelfont(item_labelfont());
-      ti->labelfgcolor(item_labelfgcolor());
-      ti->labelbgcolor(item_labelbgcolor());
-      ti->usericon(icn_[ICN_DIR]);
+      if (!lru) break;
+
+      clear_items(lru);
+      add(lru, NULL);  // dummy entry
     }
+  }
 
+  // apply the current label style and icons to the children of "ti"
+  void restyle_children(Fl_Tree_Item *ti)
+  {
     for (int i = 0; i < ti->children(); ++i) {
       auto child = ti->child(i);
       child->labelsize(item_labelsize());
@@ -353,9 +469,44 @@ protected:
       } else {
         child->usericon(icn_[ICN_DIR]);
       }
+    }
+
+    auto it = loaded_.find(ti);
+    if (it != loaded_.end()) it->second.style = style_gen_;
+  }
+
+  // update all items that can be seen, visiting each one once and
+  // recalculating the tree at the end; retained children of collapsed
+  // items are updated when they're opened again
+  void update_items(Fl_Tree_Item *ti)
+  {
+    if (!ti) {
+      return;
+    }
+
+    style_gen_++;
+
+    if (ti == root()) {
+      ti->labelsize(item_labelsize());
+      ti->labelfont(item_labelfont());
+      ti->labelfgcolor(item_labelfgcolor());
+      ti->labelbgcolor(item_labelbgcolor());
+      ti->usericon(icn_[ICN_DIR]);
+    }
 
-      // recursive call of method
-      update_items(child);
+    std::vector<Fl_Tree_Item *> stack(1, ti);
+
+    while (!stack.empty()) {
+      Fl_Tree_Item *item = stack.back();
+      stack.pop_back();
+
+      if (item->is_close()) continue;
+
+      restyle_children(item);
+
+      for (int i = 0; i < item->children(); ++i) {
+        if (item->child(i)->has_children()) stack.push_back(item->child(i));
+      }
     }
 
     recalc_tree();
@@ -392,85 +543,494 @@ protected:
     update_items(root());
   }
 
+  // read the subdirectories of "path" into "list" and sort them;
+  // stops early if "cancel" is set
+  static bool scan_dir(const std::string &path, bool hidden, sort sorter,
+                       std::vector<dir_entry_t> &list, stats *st=NULL,
+                       const std::atomic<bool> *cancel=NULL, size_t *nstat=NULL)
+  {
+    stats::scope sc(st, stats::TREE_SCAN);
+    size_t n = 0;
+    double stat_ms = 0;
+
+    auto sink = [&list] (const dirscan::entry_t &e) {
+      dir_entry_t ent;
+      ent.name = strdup(e.name);
+      ent.is_link = e.is_link;
+      list.push_back(ent);
+    };
+
+    const bool ok = dirscan::scan(path.c_str(), hidden, dirscan::DIRS_ONLY, sink, cancel,
+                                  &n, st ? &stat_ms : NULL);
+
+    if (nstat) *nstat += n;
+
+    if (st) {
+      st->add(stats::STAT, stat_ms, n);
+      st->add_entries(list.size(), n);
+    }
+
+    if (!ok) {
+      free_list(list);
+      return false;
+    }
+
+    if (!cancel || !*cancel) {
+      std::stable_sort(list.begin(), list.end(), sorter);
+    }
+
+    return true;
+  }
+
+  // add the entries [from, to) of "list" as children of "ti"
+  // and free their names
+  void add_entries(Fl_Tree_Item *ti, std::vector<dir_entry_t> &list, size_t from, size_t to)
+  {
+    stats::scope sc(stats_, stats::TREE_INSERT);
+    std::string path = item_path(ti);
+    if (path.back() != '/') path.push_back('/');
+    const size_t len = path.size();
+
+    for (size_t i = from; i < to; ++i) {
+      dir_entry_t &e = list.at(i);
+
+      add(ti, e.name);
+      auto sub = ti->child(ti->has_children() ? ti->children() - 1 : 0);
+
+      path += e.name;
+      index_[path] = sub;
+      path.resize(len);
+
+      if (e.is_link) {
+        sub->user_data(reinterpret_cast<void *>(TYPE_LINK));
+        sub->usericon(rgb_[RGB_LNK]);
+      }
+
+      close(sub, 0);
+      add(sub, NULL);  // dummy entry
+      free(e.name);
+      e.name = NULL;
+    }
+  }
+
   // open a directory from a selected Fl_Tree_Item
   bool load_tree(Fl_Tree_Item *ti)
   {
-    struct dirent *dir;
-    DIR *d;
     std::vector<dir_entry_t> list;
+    const std::string path = item_path(ti);
+    const long mtime = retain_ ? dir_mtime(path) : -1;
 
-    int fd = ::open(item_path(ti).c_str(), O_CLOEXEC | O_DIRECTORY, O_RDONLY);
-
-    if (fd == -1) {
+    if (!scan_dir(path, show_hidden(), sort(sort_mode(), sort_reverse()), list, stats_)) {
       return false;
     }
 
-    if ((d = fdopendir(fd)) == NULL) {
-      ::close(fd);
-      return false;
+    // remove dummy entry
+    cancel_scans(ti);
+    clear_items(ti);
+
+    if (list.size() == 0) {
+      close(ti, 0);
+      return true;
     }
 
-    while ((dir = readdir(d)) != NULL) {
-      struct stat st, lst;
+    add_entries(ti, list, 0, list.size());
+    mark_loaded(ti, mtime);
 
-      // handle hidden files
-      if (!show_hidden() && dir->d_name[0] == '.') {
-        continue;
-      }
+    return true;
+  }
 
-      // no "." and ".." entries
-      if (show_hidden() && (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0)) {
-        continue;
+  // the directory couldn't be opened
+  void mark_locked(Fl_Tree_Item *ti)
+  {
+    // don't add a dummy entry, so that the plus sign will disappear
+    clear_items(ti);
+
+    if (ti->user_data() == reinterpret_cast<void *>(TYPE_LINK)) {
+      ti->usericon(rgb_[RGB_LLK]);
+      ti->user_data(reinterpret_cast<void *>(TYPE_LOCKED_LINK));
+    } else {
+      ti->usericon(rgb_[RGB_LCK]);
+      ti->user_data(reinterpret_cast<void *>(TYPE_LOCKED));
+    }
+  }
+
+  // read the directory of "ti" in the background; a "loading..."
+  // child is shown until the entries are inserted
+  void start_scan(Fl_Tree_Item *ti)
+  {
+    cancel_scans(ti);
+    clear_items(ti);
+
+    scan_job_t *job = new scan_job_t;
+    job->ti = ti;
+    job->loading = add(ti, "loading...");
+    job->loading->deactivate();
+    job->path = item_path(ti);
+    job->cancel = false;
+    job->done = false;
+    job->ok = false;
+    job->mtime = -1;
+    job->inserted = 0;
+
+    const bool hidden = show_hidden();
+    const bool retain = retain_;
+    const sort sorter(sort_mode(), sort_reverse());
+    stats *st = stats_;
+
+    job->th = std::thread([job, hidden, retain, sorter, st] () {
+      if (retain) job->mtime = dir_mtime(job->path);
+      job->ok = scan_dir(job->path, hidden, sorter, job->list, st, &job->cancel);
+      job->done = true;
+    });
+
+    jobs_.push_back(job);
+
+    if (!polling_) {
+      polling_ = true;
+      Fl::add_timeout(0.02, poll_cb, this);
+    }
+  }
+
+  static bool is_below(const Fl_Tree_Item *item, const Fl_Tree_Item *ti)
+  {
+    for ( ; item; item = item->parent()) {
+      if (item == ti) return true;
+    }
+    return false;
+  }
+
+  // cancel the scans of "ti" and all items below it; must be
+  // called before their children are removed
+  void cancel_scans(Fl_Tree_Item *ti)
+  {
+    for (auto it = jobs_.begin(); it != jobs_.end(); ) {
+      if (is_below((*it)->ti, ti)) {
+        (*it)->cancel = true;
+        cancelled_.push_back(*it);
+        it = jobs_.erase(it);
+      } else {
+        ++it;
       }
+    }
+  }
+
+  static void delete_job(scan_job_t *job)
+  {
+    if (job->th.joinable()) job->th.join();
 
-      // act like lstat()
-      if (fstatat(fd, dir->d_name, &lst, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == -1) {
+    for (const auto &e : job->list) {
+      if (e.name) free(e.name);
+    }
+
+    delete job;
+  }
+
+  // insert the entries of finished scans
+  static void poll_cb(void *v)
+  {
+    dirtree *o = static_cast<dirtree *>(v);
+    bool changed = false;
+
+    for (auto it = o->jobs_.begin(); it != o->jobs_.end(); ) {
+      scan_job_t *job = *it;
+
+      if (!job->done) {
+        ++it;
         continue;
       }
 
-      // store directories and links to directories
-      if (S_ISDIR(lst.st_mode)) {
-        dir_entry_t ent;
-        ent.name = strdup(dir->d_name);
-        ent.is_link = false;
-        list.push_back(ent);
+      changed = true;
+
+      if (!job->ok) {
+        o->mark_locked(job->ti);
+      } else if (job->list.empty()) {
+        o->clear_items(job->ti);
+        o->close(job->ti, 0);
+      } else {
+        if (job->inserted == 0) o->remove(job->loading);
+
+        const size_t n = std::min(static_cast<size_t>(INSERT_BATCH), job->list.size() - job->inserted);
+        o->add_entries(job->ti, job->list, job->inserted, job->inserted + n);
+        job->inserted += n;
+
+        if (job->inserted < job->list.size()) {
+          ++it;
+          continue;
+        }
+
+        o->mark_loaded(job->ti, job->mtime);
+        o->prefetch_children(job->ti);
       }
-      else if (S_ISLNK(lst.st_mode) &&
-               fstatat(fd, dir->d_name, &st, AT_NO_AUTOMOUNT) == 0 &&  // act like stat()
-               S_ISDIR(st.st_mode))
-      {
-        dir_entry_t ent;
-        ent.name = strdup(dir->d_name);
-        ent.is_link = true;
-        list.push_back(ent);
+
+      delete_job(job);
+      it = o->jobs_.erase(it);
+    }
+
+    for (auto it = o->cancelled_.begin(); it != o->cancelled_.end(); ) {
+      if ((*it)->done) {
+        delete_job(*it);
+        it = o->cancelled_.erase(it);
+      } else {
+        ++it;
       }
     }
 
-    closedir(d);
-    ::close(fd);
+    if (changed) o->redraw();
 
-    // remove dummy entry
-    ti->clear_children();
+    if (!o->jobs_.empty() || !o->cancelled_.empty()) {
+      Fl::repeat_timeout(0.02, poll_cb, v);
+    } else {
+      o->polling_ = false;
+    }
+  }
 
-    if (list.size() == 0) {
+  // stop all scans and close their items again, deepest first,
+  // so that they're read again when they're opened
+  void reset_scans()
+  {
+    std::vector<Fl_Tree_Item *> items;
+
+    for (const auto job : jobs_) {
+      items.push_back(job->ti);
+    }
+
+    cancel_scans(root());
+
+    std::sort(items.begin(), items.end(), [] (Fl_Tree_Item *a, Fl_Tree_Item *b) {
+      return a->depth() > b->depth();
+    });
+
+    for (auto ti : items) {
+      clear_items(ti);
       close(ti, 0);
+      add(ti, NULL);  // dummy entry
+    }
+  }
+
+  // open the items of a path one by one
+  bool load_path(const char *inPath)
+  {
+    if (filetable_::empty(inPath)) {
+      return false;
+    }
+
+    // the items on the way must be complete and prefetches queued
+    // for the previous location aren't needed anymore
+    reset_scans();
+
+    { std::lock_guard<std::mutex> lock(pf_mtx_);
+      pf_queue_.clear();
+    }
+
+    if (inPath[0] == '/' && inPath[1] == 0) {
+      return load_root();
+    }
+
+    std::string s = filetable_::simplify_directory_path(inPath);
+    if (s.empty()) s = inPath;
+    while (s.size() > 1 && s.back() == '/') s.pop_back();
+
+    load_root();
+    if (s == "/") return true;
+
+    // open subdirectories step by step; each item is looked up in
+    // the index, which is filled by opening its parent
+    for (size_t pos = s.find('/', 1); ; pos = s.find('/', pos + 1)) {
+      auto it = index_.find(pos == std::string::npos ? s : s.substr(0, pos));
+      if (it == index_.end()) return false;
+
+      open(it->second);
+      if (pos == std::string::npos) break;
+    }
+
+    // return false if we have no read access
+    return (access(s.c_str(), R_OK) == 0);
+  }
+
+  // true for NFS, SMB and other file systems where reading
+  // a directory can be slow
+  static bool is_network_fs(const char *path)
+  {
+#ifdef __linux__
+    struct statfs sfs;
+
+    if (statfs(path, &sfs) == -1) {
       return true;
     }
 
-    std::stable_sort(list.begin(), list.end(), sort(sort_mode(), sort_reverse()));
+    switch (static_cast<unsigned long>(sfs.f_type)) {
+      case 0x6969:      // NFS
+      case 0x517b:      // SMB
+      case 0xff534d42:  // CIFS
+      case 0xfe534d42:  // SMB2
+      case 0x73757245:  // CODA
+      case 0x5346414f:  // AFS
+      case 0x00c36400:  // CEPH
+      case 0x01021997:  // 9P
+      case 0x65735546:  // FUSE (sshfs and friends)
+      case 0x564c:      // NCP
+        return true;
+      default:
+        break;
+    }
+#else
+    (void)path;
+#endif
+    return false;
+  }
 
+  static void free_list(std::vector<dir_entry_t> &list)
+  {
     for (const auto &e : list) {
-      add(ti, e.name);
-      auto sub = ti->child(ti->has_children() ? ti->children() - 1 : 0);
+      if (e.name) free(e.name);
+    }
+    list.clear();
+  }
 
-      if (e.is_link) {
-        sub->user_data(reinterpret_cast<void *>(TYPE_LINK));
-        sub->usericon(rgb_[RGB_LNK]);
+  // read the queued directories ahead of time
+  void prefetch_worker()
+  {
+#ifdef __linux__
+    // lowest CPU priority and idle I/O class for this thread only
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#ifdef SYS_ioprio_set
+    syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, 3 << 13 /* IOPRIO_CLASS_IDLE */);
+#endif
+#endif
+
+    for (;;) {
+      std::string path;
+      bool hidden, network, reverse;
+      uint mode;
+
+      { std::unique_lock<std::mutex> lock(pf_mtx_);
+        pf_cv_.wait(lock, [this] { return pf_stop_ || !pf_queue_.empty(); });
+        if (pf_stop_) return;
+        path = pf_queue_.front();
+        pf_queue_.pop_front();
+        hidden = pf_hidden_;
+        mode = pf_sort_mode_;
+        reverse = pf_sort_reverse_;
+        network = pf_network_;
       }
 
-      close(sub, 0);
-      add(sub, NULL);  // dummy entry
-      free(e.name);
+      prefetched_t pf;
+      struct stat st;
+
+      // the mtime is taken first, so that changes made while
+      // reading the directory invalidate the entry
+      if (stat(path.c_str(), &st) == -1 || !S_ISDIR(st.st_mode) ||
+          (!network && is_network_fs(path.c_str())) ||
+          !scan_dir(path, hidden, sort(mode, reverse), pf.list))
+      {
+        continue;
+      }
+
+      pf.mtime = static_cast<long>(st.st_mtime);
+      pf.hidden = hidden;
+      pf.sort_mode = mode;
+      pf.sort_reverse = reverse;
+
+      std::lock_guard<std::mutex> lock(pf_mtx_);
+
+      auto it = pf_cache_.find(path);
+
+      if (it != pf_cache_.end()) {
+        free_list(it->second.list);
+        pf_lru_.erase(it->second.lru);
+        pf_cache_.erase(it);
+      }
+
+      // drop the directories that were read the longest time ago;
+      // entries are removed when they're used, so these are the
+      // ones least likely to be opened
+      while (pf_cache_.size() >= PREFETCH_MAX && !pf_lru_.empty()) {
+        auto old = pf_cache_.find(pf_lru_.back());
+        free_list(old->second.list);
+        pf_cache_.erase(old);
+        pf_lru_.pop_back();
+      }
+
+      pf_lru_.push_front(path);
+      pf.lru = pf_lru_.begin();
+      pf_cache_[path] = std::move(pf);
+    }
+  }
+
+  // queue the subdirectories of an expanded item for the prefetcher;
+  // anything still queued from earlier expansions is dropped
+  void prefetch_children(Fl_Tree_Item *ti)
+  {
+    if (!prefetch_ || prefetch_budget_ < 1 || !ti->has_children()) {
+      return;
+    }
+
+    std::string base = item_path(ti);
+    if (base.back() != '/') base.push_back('/');
+
+    { std::lock_guard<std::mutex> lock(pf_mtx_);
+      pf_queue_.clear();
+      pf_hidden_ = show_hidden();
+      pf_sort_mode_ = sort_mode();
+      pf_sort_reverse_ = sort_reverse();
+      pf_network_ = prefetch_network_;
+
+      for (int i = 0; i < ti->children() && static_cast<int>(pf_queue_.size()) < prefetch_budget_; ++i) {
+        Fl_Tree_Item *child = ti->child(i);
+        void *ptr = child->user_data();
+        const char *l = child->label();
+
+        if (!l || !*l || ptr == reinterpret_cast<void *>(TYPE_LOCKED) ||
+            ptr == reinterpret_cast<void *>(TYPE_LOCKED_LINK))
+        {
+          continue;
+        }
+
+        const std::string path = base + l;
+        if (pf_cache_.count(path) == 0) pf_queue_.push_back(path);
+      }
+
+      if (pf_queue_.empty()) return;
+    }
+
+    if (!pf_thread_.joinable()) {
+      pf_thread_ = std::thread(&dirtree::prefetch_worker, this);
+    }
+
+    pf_cv_.notify_one();
+  }
+
+  // insert the prefetched entries of "ti" if they're still up to date
+  bool load_prefetched(Fl_Tree_Item *ti)
+  {
+    const std::string path = item_path(ti);
+    prefetched_t pf;
+    struct stat st;
+
+    { std::lock_guard<std::mutex> lock(pf_mtx_);
+      auto it = pf_cache_.find(path);
+      if (it == pf_cache_.end()) return false;
+      pf = std::move(it->second);
+      pf_lru_.erase(pf.lru);
+      pf_cache_.erase(it);
+    }
+
+    if (stat(path.c_str(), &st) == -1 || static_cast<long>(st.st_mtime) != pf.mtime ||
+        pf.hidden != show_hidden() || pf.sort_mode != sort_mode() ||
+        pf.sort_reverse != sort_reverse())
+    {
+      free_list(pf.list);
+      return false;
+    }
+
+    cancel_scans(ti);
+    clear_items(ti);
+
+    if (pf.list.empty()) {
+      close(ti, 0);
+    } else {
+      add_entries(ti, pf.list, 0, pf.list.size());
+      mark_loaded(ti, pf.mtime);
     }
 
     return true;
@@ -496,13 +1056,68 @@ public:
 
   virtual ~dirtree()
   {
-    for (int i=0; i < ICN_NUM; ++i) {
-      if (def_[i]) delete def_[i];
+    { std::lock_guard<std::mutex> lock(pf_mtx_);
+      pf_stop_ = true;
+      pf_queue_.clear();
+    }
+
+    pf_cv_.notify_all();
+    if (pf_thread_.joinable()) pf_thread_.join();
+
+    for (auto &e : pf_cache_) {
+      free_list(e.second.list);
+    }
+
+    Fl::remove_timeout(poll_cb, this);
+    cancel_scans(root());
+
+    for (auto job : cancelled_) {
+      delete_job(job);
     }
 
     for (int i=0; i < RGB_NUM; ++i) {
       if (rgb_[i]) delete rgb_[i];
     }
+
+    for (const auto img : copies_) {
+      delete img;
+    }
+  }
+
+  // number of subdirectories (including links to directories) of "path"
+  // as the tree would list them, or -1 on error; "nstat" is increased by
+  // the number of stat() calls that were needed
+  static long count_subdirs(const char *path, bool hidden, size_t *nstat=NULL)
+  {
+    std::vector<dir_entry_t> list;
+
+    if (!path || !scan_dir(path, hidden, sort(0, false), list, NULL, NULL, nstat)) {
+      return -1;
+    }
+
+    for (auto &ent : list) {
+      free(ent.name);
+    }
+
+    return static_cast<long>(list.size());
+  }
+
+  // return the item of an absolute path or NULL if it's not in the tree
+  Fl_Tree_Item *find_path(const char *path)
+  {
+    if (filetable_::empty(path) || path[0] != '/') {
+      return NULL;
+    }
+
+    size_t len = strlen(path);
+    while (len > 1 && path[len - 1] == '/') len--;
+
+    if (len == 1) {
+      return root();
+    }
+
+    auto it = index_.find(std::string(path, len));
+    return (it == index_.end()) ? NULL : it->second;
   }
 
   // return the path of the last selected item or NULL
@@ -513,82 +1128,82 @@ public:
     return callback_item_path_.empty() ? NULL : callback_item_path_.c_str();
   }
 
-  // a '+' sign was clicked
+  // a '+' sign was clicked; the directory is read in the background
+  // unless it's opened by load_dir() or was prefetched; the
+  // subdirectories of items opened by a click are prefetched
   void open_callback_item()
   {
     Fl_Tree_Item *ti = callback_item();
 
-    if (!load_tree(ti)) {
-      // don't add a dummy entry, so that the plus sign will disappear
-      ti->clear_children();
+    // retained children are kept if they're up to date
+    if (retain_ && revalidate(ti)) {
+      return;
+    }
 
-      if (ti->user_data() == reinterpret_cast<void *>(TYPE_LINK)) {
-        ti->usericon(rgb_[RGB_LLK]);
-        ti->user_data(reinterpret_cast<void *>(TYPE_LOCKED_LINK));
-      } else {
-        ti->usericon(rgb_[RGB_LCK]);
-        ti->user_data(reinterpret_cast<void *>(TYPE_LOCKED));
-      }
+    if (sync_open_ > 0) {
+      if (!load_tree(ti)) mark_locked(ti);
+    } else if (load_prefetched(ti)) {
+      prefetch_children(ti);
+    } else if (async_) {
+      start_scan(ti);
+    } else if (load_tree(ti)) {
+      prefetch_children(ti);
+    } else {
+      mark_locked(ti);
     }
   }
 
-  // a '-' sign was clicked
+  // a '-' sign was clicked; this also cancels a running scan;
+  // retained children are kept
   void close_callback_item()
   {
     Fl_Tree_Item *ti = callback_item();
-    ti->clear_children();
+    const size_t running = jobs_.size();
+    cancel_scans(ti);
+
+    if (retain_ && jobs_.size() == running && loaded_.count(ti) > 0) {
+      trim_retained();
+      return;
+    }
+
+    clear_items(ti);
     close(ti, 0);
     add(ti, NULL); // dummy entry so the plus sign appears
   }
 
-  // load a directory from a given path
+  // load a directory from a given path; the directories
+  // on the way are read right away
   bool load_dir(const char *inPath)
   {
-    if (filetable_::empty(inPath)) {
-      return false;
-    }
-
-    if (inPath[0] == '/' && inPath[1] == 0) {
-      return load_root();
-    }
-
-    std::string s = filetable_::simplify_directory_path(inPath);
-    if (s.empty()) s = inPath;
-    char *p = const_cast<char *>(s.data());
+    sync_open_++;
+    const bool rv = load_path(inPath);
+    sync_open_--;
 
-    load_root();
-
-    // Fl_Tree::open() returns
-    //     -   1 -- OK: item opened
-    //     -   0 -- OK: item was already open, no change
-    //     -  -1 -- ERROR: item was not found
-
-    // open subdirectories step by step
-    while (*++p) {
-      if (*p != '/') continue;
-      *p = 0;
-      if (open(s.data()) == -1) return false;
-      *p = '/';
-    }
-
-    // finally open the full path
-    // return false if Fl_Tree::open() failed or if we have no read access
-
-    if (open(s.c_str()) == -1 || access(s.c_str(), R_OK) == -1) {
-      return false;
-    }
-
-    return true;
+    return rv;
   }
 
   // same as load_dir("/")
-  bool load_root() {
+  bool load_root()
+  {
     // Fl_Tree::open(root()) will "reset" the entire root tree!
-    return (open(root()) != -1);
+    sync_open_++;
+    const bool rv = (open(root()) != -1);
+    sync_open_--;
+
+    return rv;
   }
 
-  // close the tree
-  void close_root() {
+  // close the tree; retained subtrees are only collapsed
+  void close_root()
+  {
+    if (retain_ && loaded_.count(root()) > 0) {
+      for (Fl_Tree_Item *ti = first(); ti; ti = next(ti)) {
+        if (ti->is_open()) close(ti, 0);
+      }
+      trim_retained();
+      return;
+    }
+
     close(root(), 0);
     add(root(), NULL);  // dummy entry
   }
@@ -596,23 +1211,8 @@ public:
   // load a set of default icons
   void load_default_icons()
   {
-    const char *data[ICN_NUM] = {
-      FOLDER_GENERIC_SVG_DATA,
-      OVERLAY_LINK_BIG_SVG_DATA,
-      OVERLAY_PADLOCK_BIG_SVG_DATA
-    };
-
     for (int i=0; i < ICN_NUM; ++i) {
-      if (def_[i]) delete def_[i];
-      def_[i] = new Fl_SVG_Image(NULL, data[i]);
-
-      if (!def_[i]) continue;
-
-      if (def_[i]->fail()) {
-        delete def_[i];
-        def_[i] = NULL;
-        continue;
-      }
+      def_[i] = icon_cache::get(NULL, default_icon_data(i), item_labelsize());
       usericon(def_[i], i);
     }
 
@@ -645,13 +1245,20 @@ public:
   {
     Fl_Tree::item_labelsize(val);
 
-    if (icn_[ICN_DIR]) {
-      icn_[ICN_DIR]->resize(val, val);
-      Fl_Tree::usericon(icn_[ICN_DIR]);
+    for (int i=0; i < ICN_NUM; ++i) {
+      if (!icn_[i]) continue;
+
+      if (icn_[i] == def_[i]) {
+        // default icons are shared; get a copy of the new size
+        def_[i] = icon_cache::get(NULL, default_icon_data(i), val);
+        usericon(def_[i], i);
+      } else {
+        // copied again from the image that was set
+        usericon(user_[i], i);
+      }
     }
 
-    if (icn_[ICN_LNK]) icn_[ICN_LNK]->resize(val, val);
-    if (icn_[ICN_LCK]) icn_[ICN_LCK]->resize(val, val);
+    if (icn_[ICN_DIR]) Fl_Tree::usericon(icn_[ICN_DIR]);
 
     update_items(true);
   }
@@ -690,6 +1297,37 @@ public:
 
   void sort_mode(uint u) { sort_mode_ = u; }
   uint sort_mode() const { return sort_mode_; }
+
+  // read directories opened by a click in the background
+  void async(bool b) { async_ = b; }
+  bool async() const { return async_; }
+
+  // read the subdirectories of items opened by a click ahead of
+  // time on a low priority thread, up to "budget" directories per
+  // opened item; network file systems are skipped unless enabled
+  void prefetch(bool b) { prefetch_ = b; }
+  bool prefetch() const { return prefetch_; }
+
+  void prefetch_budget(int i) { prefetch_budget_ = i; }
+  int prefetch_budget() const { return prefetch_budget_; }
+
+  void prefetch_network(bool b) { prefetch_network_ = b; }
+  bool prefetch_network() const { return prefetch_network_; }
+
+  // keep the children of collapsed items; they're checked against the
+  // mtime of their directory when the item is opened again, and the
+  // least recently used ones are dropped when the tree has more than
+  // retain_max() items
+  void retain_subtrees(bool b) { retain_ = b; }
+  bool retain_subtrees() const { return retain_; }
+
+  void retain_max(size_t n) { retain_max_ = n; }
+  size_t retain_max() const { return retain_max_; }
+
+  // record timings into "s" (see fltk::stats), which must outlive
+  // this widget; NULL turns it off
+  void instrument(stats *s) { stats_ = s; }
+  stats *instrument() const { return stats_; }
 };
 
 } // namespace fltk
@@ -36,6 +36,7 @@
 #include <FL/Fl_Input.H>
 #include <FL/Fl_Tabs.H>
 #include <FL/Fl_Tile.H>
+#include <FL/fl_ask.H>
 #include <FL/filename.H>
 
 #include <algorithm>
@@ -59,6 +60,8 @@
 #include "fltk_filetable_simple.hpp"
 #include "fltk_filetable_extension.hpp"
 #include "fltk_mountbutton.hpp"
+#include "fltk_preview.hpp"
+#include "fuzzy_match.hpp"
 #include "xdg_dirs.hpp"
 
 #ifdef FLTK_EXPERIMENTAL
@@ -120,6 +123,8 @@ private:
   class addressline : public Fl_Input
   {
   private:
+    fileselection *fs_ptr;
+
     Fl_Menu_Item menu_[4] = {
       { "Copy selection", 0, copy_selection_cb, this, FL_MENU_INACTIVE },
       { "Copy line",      0, copy_cb,           this, FL_MENU_DIVIDER },
@@ -131,9 +136,23 @@ private:
     {
       switch (event) {
         case FL_UNFOCUS:
+          if (!readonly()) fs_ptr->quick_open_cancel();
           position(0);
           break;
 
+        case FL_KEYBOARD:
+          // quick open: accept or dismiss the typed query
+          if (!readonly()) {
+            if (Fl::event_key() == FL_Enter) {
+              fs_ptr->quick_open_accept();
+              return 1;
+            } else if (Fl::event_key() == FL_Escape) {
+              fs_ptr->quick_open_cancel();
+              return 1;
+            }
+          }
+          break;
+
         case FL_PUSH:
           if (Fl::event_button() == FL_RIGHT_MOUSE) {
             // change cursor back to default
@@ -168,7 +187,8 @@ private:
     }
 
   public:
-    addressline(int X, int Y, int W, int H) : Fl_Input(X,Y,W,H, NULL) {
+    addressline(int X, int Y, int W, int H, fileselection *fs) : Fl_Input(X,Y,W,H, NULL) {
+      fs_ptr = fs;
       readonly(1);
     }
   };
@@ -182,6 +202,13 @@ private:
     UUID_MAX_SIZE = 36  // UUID length
   };
 
+  // quick open: fuzzy matching on the current listing and
+  // the history entries, typed into the address line
+  fuzzy_match fuzzy_;
+  std::vector<std::string> fuzzy_paths_;  // full paths of the candidates
+  size_t fuzzy_listed_ = 0;  // number of candidates taken from the listing
+  bool fuzzy_dirty_ = true;
+
   Fl_Menu_Item mprev_[HISTORY_MAX + 1] = {0};
   Fl_Menu_Item mnext_[HISTORY_MAX + 1] = {0};
 
@@ -213,6 +240,7 @@ private:
 
   dirtree *tree_;
   filetable_sub *table_;
+  preview *preview_;
   addressline *addr_;
   mountbutton *mnt_but1;
   Fl_Box *mnt_dummy;
@@ -542,13 +570,10 @@ private:
   // return size in IEC or SI format
   std::string human_readable_filesize_iec(long bytes, bool force_iec)
   {
-    bool b = table_->use_iec();  // save
-    table_->use_iec(force_iec);
-    char *size = table_->human_readable_filesize(bytes);
-    table_->use_iec(b);  // restore
-    std::string s = size;
-    free(size);
-    while (isspace(s.back())) s.pop_back();
+    char buf[64];
+    table_->format_filesize(buf, sizeof(buf), bytes, force_iec);
+    std::string s = buf;
+    while (!s.empty() && isspace(s.back())) s.pop_back();
     return s;
   }
 
@@ -686,6 +711,7 @@ private:
 
     const char *dir = table_->open_directory();
     addr_->value(dir);
+    fuzzy_dirty_ = true;
     if (update_tree) tree_->close_root();
     if (!dir) return false;
 
@@ -704,7 +730,7 @@ private:
         b_up->activate();
         // scroll down tree
         if (rv) {
-          auto item = tree_->find_item(dir);
+          auto item = tree_->find_path(dir);
           tree_->show_item(item);
           tree_->set_item_focus(item);
         }
@@ -747,31 +773,151 @@ private:
     return rv;
   }
 
-  // move up the tree until we can open a directory, otherwise open root
-  void move_up_tree(const char *dirname=NULL)
+  // collect the quick open candidates: entries of the current
+  // directory first, followed by the history entries
+  void quick_open_candidates()
+  {
+    const char *dir = table_->open_directory();
+    std::string base;
+
+    if (dir) {
+      base = dir;
+      if (base.back() != '/') base.push_back('/');
+    }
+
+    fuzzy_.clear();
+    fuzzy_paths_.clear();
+    fuzzy_.reserve(table_->entries() + vprev_.size() + vnext_.size());
+    fuzzy_paths_.reserve(table_->entries() + vprev_.size() + vnext_.size());
+
+    for (size_t i = 0; i < table_->entries(); ++i) {
+      const char *name = table_->entry_name(i);
+      fuzzy_.add(name);
+      fuzzy_paths_.emplace_back(base + name);
+    }
+
+    fuzzy_listed_ = fuzzy_paths_.size();
+
+    for (const auto &vec : { &vprev_, &vnext_ }) {
+      for (const path_t &p : *vec) {
+        fuzzy_.add(p.path.c_str());
+        fuzzy_paths_.emplace_back(p.path);
+      }
+    }
+
+    fuzzy_dirty_ = false;
+  }
+
+  // called on every change of the address line's text
+  void quick_open_update()
+  {
+    const char *query = addr_->value();
+
+    // a path is being typed
+    if (empty(query) || query[0] == '/') return;
+
+    if (fuzzy_dirty_) quick_open_candidates();
+
+    const auto &res = fuzzy_.search(query, 1);
+    if (res.empty()) return;
+
+    // highlight the best match if it's in the current listing;
+    // select it by name because the table may have been sorted
+    // since the candidates were collected
+    if (res.at(0).index < fuzzy_listed_) {
+      const std::string &path = fuzzy_paths_.at(res.at(0).index);
+      table_->select_entry(path.c_str() + path.rfind('/') + 1);
+    }
+  }
+
+  // Enter was pressed in the address line
+  void quick_open_accept()
+  {
+    const char *query = addr_->value();
+
+    if (empty(query)) {
+      quick_open_cancel();
+      return;
+    }
+
+    // load a typed path directly
+    if (query[0] == '/') {
+      std::string s = query;
+      load_dir(s.c_str());
+      return;
+    }
+
+    if (fuzzy_dirty_) quick_open_candidates();
+
+    const auto &res = fuzzy_.search(query, 1);
+
+    if (res.empty()) {
+      fl_beep();
+      return;
+    }
+
+    std::string path = fuzzy_paths_.at(res.at(0).index);
+
+    if (fl_filename_isdir(path.c_str())) {
+      load_dir(path.c_str());
+    } else {
+      // set selection and quit
+      selection_ = path;
+      window()->hide();
+    }
+  }
+
+  // restore the address line
+  void quick_open_cancel() {
+    addr_->value(table_->open_directory());
+  }
+
+  // true if the table_->load_dir() call that was started at generation
+  // "gen" was overtaken by a newer one while it was handling events,
+  // i.e. the user already navigated somewhere else, or if it was made
+  // during another load and only queued its directory; the outer
+  // call finishes the navigation then
+  bool superseded(unsigned gen) const {
+    return (table_->loading() || table_->generation() != gen + 1);
+  }
+
+  // move up the tree until we can open a directory, otherwise open root;
+  // returns false if a newer navigation took over or this widget was
+  // deleted meanwhile, in which case nothing must be touched anymore
+  bool move_up_tree(const char *dirname=NULL)
   {
     if (!dirname) dirname = table_->open_directory();
-    if (!dirname) return;
+    if (!dirname) return true;
 
     std::string s = filetable_::simplify_directory_path(dirname);
     char * const path = const_cast<char *>(s.data());
     char *p = path + s.length();
+    Fl_Widget_Tracker tracker(table_);
 
     while (p-- != path) {
       if (*p == '/') {
         *p = 0;
+        const unsigned gen = table_->generation();
         if (table_->load_dir(path)) break;
+        if (tracker.deleted() || superseded(gen)) return false;
       }
     }
 
     if (*path == 0) {
       // moved all the way up to the root directory
       tree_->close_root();
-      table_->load_dir("/");
+      const unsigned gen = table_->generation();
+
+      if (!table_->load_dir("/") && (tracker.deleted() || superseded(gen))) {
+        return false;
+      }
     } else {
       // close path
-      tree_->close(path, 0);
+      auto item = tree_->find_path(path);
+      if (item) tree_->close(item, 0);
     }
+
+    return true;
   }
 
   void toggle_hidden() {
@@ -965,7 +1111,17 @@ private:
       b_ok->deactivate();
     }
 
-    return Fl_Group::handle(event);
+    // loading a directory handles events, which may delete this widget
+    Fl_Widget_Tracker tracker(this);
+    const int rv = Fl_Group::handle(event);
+    if (tracker.deleted()) return rv;
+
+    // the selection only changes on clicks and key presses
+    if (preview_->visible() && (event == FL_RELEASE || event == FL_KEYUP)) {
+      preview_->load(table_->last_clicked_item());
+    }
+
+    return rv;
   }
 
 public:
@@ -1004,7 +1160,9 @@ public:
     {
       Fl_Widget *o;
 
-      addr_ = new addressline(X, Y, W, addr_h);
+      addr_ = new addressline(X, Y, W, addr_h, this);
+      addr_->when(FL_WHEN_CHANGED);
+      addr_->ADD_CB(quick_open_update);
       const int but_y = addr_->y() + addr_->h() + spacing;
 
 /*
@@ -1101,9 +1259,14 @@ public:
       tree_ = new dirtree(X, Y + g_top->h(), W/4, main_h);
       tree_->ADD_CB(tree_callback);
       tree_->selection_color(FL_WHITE);
+      tree_->retain_subtrees(true);  // load_dir() collapses and reopens the tree
 
       table_ = new filetable_sub(X + W/4, Y + g_top->h(), W - W/4, main_h, this);
 
+      // hidden until show_preview(true) is called
+      preview_ = new preview(X + W, Y + g_top->h(), 0, main_h);
+      preview_->hide();
+
       //tree_->selection_color(table_->selection_color());
     }
     g_main->end();
@@ -1189,6 +1352,7 @@ public:
     stop_thread();
     if (tree_) delete tree_;
     if (table_) delete table_;
+    if (preview_) delete preview_;
   }
 
   void cancel() {
@@ -1210,15 +1374,23 @@ public:
   // calls load_dir() on table_ and tree_
   bool load_dir(const char *dirname, bool update_tree=true)
   {
+    stats::scope sc(table_->instrument(), stats::LOAD);
     std::string s;
 
     if (table_->open_directory()) {
       s = table_->open_directory();
     }
 
+    // table_ handles events while it's loading; they may delete
+    // this widget (and with it table_) or navigate somewhere else
+    Fl_Widget_Tracker tracker(table_);
+    const unsigned gen = table_->generation();
+
     if (!table_->load_dir(dirname)) {
+      if (tracker.deleted() || superseded(gen)) return false;
+
       if (dirname[0] == '/') {
-        move_up_tree(dirname);
+        if (!move_up_tree(dirname)) return false;
       } else {
         add_partitions();
         return false;
@@ -1243,7 +1415,14 @@ public:
       s = table_->open_directory();
     }
 
-    if (!table_->dir_up()) move_up_tree();
+    Fl_Widget_Tracker tracker(table_);
+    const unsigned gen = table_->generation();
+
+    if (!table_->dir_up()) {
+      if (tracker.deleted() || superseded(gen)) return false;
+      if (!move_up_tree()) return false;
+    }
+
     add_to_history(s.c_str(), vprev_);
 
     return load_open_directory(false, true);
@@ -1334,8 +1513,12 @@ public:
       s = table_->open_directory();
     }
 
+    Fl_Widget_Tracker tracker(table_);
+    const unsigned gen = table_->generation();
+
     if (!table_->refresh()) {
-      move_up_tree();
+      if (tracker.deleted() || superseded(gen)) return false;
+      if (!move_up_tree()) return false;
       add_to_history(s.c_str(), vprev_);
     }
 
@@ -1373,6 +1556,50 @@ public:
   void blend_w(int i) {table_->blend_w(i);}
   int blend_w() const {return table_->blend_w();}
 
+  void multi_select(bool b) {table_->multi_select(b);}
+  bool multi_select() const {return table_->multi_select();}
+  std::vector<std::string> selected_paths() {return table_->selected_paths();}
+
+  void thumbnails(bool b) {table_->thumbnails(b);}
+  bool thumbnails() const {return table_->thumbnails();}
+  void grid_view(bool b) {table_->grid_view(b);}
+  bool grid_view() const {return table_->grid_view();}
+
+  void calculate_selected_dir_sizes() {table_->calculate_selected_dir_sizes();}
+  void calculate_visible_dir_sizes() {table_->calculate_visible_dir_sizes();}
+  void cancel_dir_sizes() {table_->cancel_dir_sizes();}
+
+  // show a preview of the selected file right of the table
+  void show_preview(bool b)
+  {
+    if (b == (preview_->visible() != 0)) return;
+
+    if (b) {
+      const int pw = table_->w() / 3;
+      table_->size(table_->w() - pw, table_->h());
+      preview_->resize(table_->x() + table_->w(), table_->y(), pw, table_->h());
+      preview_->show();
+      preview_->load(table_->last_clicked_item());
+    } else {
+      preview_->hide();
+      preview_->clear();
+      table_->size(table_->w() + preview_->w(), table_->h());
+      preview_->resize(table_->x() + table_->w(), table_->y(), 0, table_->h());
+    }
+
+    g_main->init_sizes();
+    g_main->redraw();
+  }
+
+  bool show_preview() const {return preview_->visible() != 0;}
+  void preview_max_bytes(size_t n) {preview_->max_bytes(n);}
+  size_t preview_max_bytes() const {return preview_->max_bytes();}
+
+  // record timings of table_ and tree_ into "s" (see fltk::stats),
+  // which must outlive this widget; NULL turns it off
+  void instrument(stats *s) {table_->instrument(s); tree_->instrument(s);}
+  stats *instrument() const {return table_->instrument();}
+
   void autowidth_padding(int i) {table_->autowidth_padding(i);}
   int autowidth_padding() const {return table_->autowidth_padding();}
 
@@ -1390,6 +1617,11 @@ public:
 
   void use_iec(bool b) { table_->use_iec(b); }
   bool use_iec() const { return table_->use_iec(); }
+
+  // allow typing into the address line to fuzzy-search the current
+  // directory and the history; Enter opens the best match
+  void quick_open(bool b) { addr_->readonly(b ? 0 : 1); }
+  bool quick_open() const { return addr_->readonly() == 0; }
 };
 
 } // namespace fltk
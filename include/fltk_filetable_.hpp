@@ -31,12 +31,15 @@
 #include <FL/Fl_SVG_Image.H>
 
 #include <algorithm>
+#include <atomic>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <assert.h>
 #include <errno.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,6 +49,13 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "fltk_dircount.hpp"
+#include "fltk_dirscan.hpp"
+#include "fltk_dirsize.hpp"
+#include "fltk_icon_cache.hpp"
+#include "fltk_stats.hpp"
+#include "fltk_thumbnailer.hpp"
+#include "rgba_blend.hpp"
 #include "svg_data.h"
 
 #ifndef FLTK_FMT_LONG
@@ -100,6 +110,22 @@ protected:
     ENTRY_ALLOCATED = 'x'
   };
 
+  // value of Row_t::bytes for directories that weren't counted yet
+  // (huge directory mode)
+  enum {
+    BYTES_UNCOUNTED = -2
+  };
+
+  // number of rows measured by autowidth() in huge directory mode
+  enum {
+    AUTOWIDTH_SAMPLES = 1000
+  };
+
+  // Row_t::id of no row
+  enum : uint32_t {
+    ID_NONE = 0xffffffff
+  };
+
   enum EIcn {
     ICN_DIR = 0,  // directory
     ICN_FILE,     // regular file
@@ -112,17 +138,20 @@ protected:
     ICN_LAST
   };
 
-  // single row of columns
+  // single row of columns;
+  // the size and date columns are usually NULL and
+  // formatted on demand by cell_text()
   typedef struct {
     char *cols[COL_MAX] = {0};
     char *label = NULL;
     Fl_SVG_Image *svg = NULL;
-    char type = 0;
-    bool isdir() const { return (type == 'D'); }
     long bytes = 0;
     long last_mod = 0;
+    char type = 0;
+    bool isdir() const { return (type == 'D'); }
     bool is_link = false;
-    bool selected = false;
+    uint32_t id = 0;  // stable across sort and refresh; index of selected_
+    ino_t ino = 0;    // 0 if unknown; tells a replaced file from the old one
   } Row_t;
 
 private:
@@ -140,7 +169,7 @@ private:
 
 #define COMPARE(A,B) (_reverse?(A>B):(A<B))
 
-    bool operator() (Row_t a, Row_t b) {
+    bool operator() (const Row_t &a, const Row_t &b) {
       if (_col >= COL_MAX) return false;
 
       const char *ap = a.cols[_col];
@@ -210,6 +239,29 @@ private:
   // show hidden files or not
   bool show_hidden_ = false;
 
+  // huge directory mode: don't count directory entries until they
+  // are shown and only measure a sample of rows in autowidth()
+  bool huge_mode_ = false;
+
+  // strftime() format of the date column
+  std::string date_format_ = "%c";
+
+  // direct-mapped cache of formatted size and date strings, keyed by
+  // value so it stays valid when the rows are sorted; it's allocated
+  // once and reused, so drawing a cell never calls malloc()
+  enum {
+    FMT_CACHE_SLOTS = 256,  // must be a power of 2
+    FMT_CACHE_LEN = 64
+  };
+
+  typedef struct {
+    long key;
+    char type;  // 0 = unused, 'B' = bytes, 'E' = elements, 'T' = time
+    char str[FMT_CACHE_LEN];
+  } fmt_cache_t;
+
+  std::vector<fmt_cache_t> fmt_cache_;
+
   // save the known number of directory entries to this value on a
   // double click before loading so we can use it to reserve space
   // in the rowdata_ vector, as an attempt to reduce unneeded reallocation
@@ -218,19 +270,23 @@ private:
   // list of filename extensions to filter in
   std::vector<std::string> filter_list_;
 
-  // icons used for a filename "blend-over" effect;
-  // 2 colors for selected and unselected row
-  Fl_RGB_Image *icon_blend_[2] = {0};
+  // images used for a filename "blend-over" effect, keyed by
+  // color and size; they're generated in draw() so that
+  // draw_cell() never needs to allocate
+  typedef struct {
+    Fl_Color color;
+    int w;
+    int h;
+    Fl_RGB_Image *img;
+  } fade_t;
+
+  enum { FADE_CACHE_MAX = 8 };
+  std::vector<fade_t> fade_cache_;
 
   // width of the filename blend-over area in pixels;
   // 0 will disable this effect
   int blend_w_ = 8;
 
-  // height of blend-over area; keep this initially at 0
-  // so we won't call make_overlay_image() before we even
-  // drew any table rows
-  int blend_h_ = 0;
-
   // labels of the header entries
   const char *label_header_[COL_MAX] = {
     "Name", "Size", "Type", "Last modified"
@@ -261,10 +317,88 @@ private:
       FLTK_FMT_FLOAT " TiB " }
   };
 
-  // this string is used to be strdup()ed instead of being
-  // created with printf_alloc() each time
+  // size labels split into the text before and after the number, so
+  // that format_filesize() doesn't need to parse a format string
+  typedef struct {
+    std::string pre;
+    std::string post;
+    bool fast;  // false if the label must be passed to snprintf()
+  } size_tmpl_t;
+
+  size_tmpl_t filesize_tmpl_[STR_SIZE_MAX][2];
+
+  // LC_NUMERIC decimal point at the time the labels were compiled
+  std::string decimal_point_ = ".";
+
+  // shown for directories that couldn't be counted
   std::string str_unknown_elements_ = "?? elements ";
 
+  // icons pre-blended with the link and/or lock overlay;
+  // index 0 is link, 1 is lock, 2 is both; NULL until blended
+  typedef struct {
+    Fl_SVG_Image *svg;
+    Fl_RGB_Image *rgb[3];
+  } composite_t;
+
+  std::vector<composite_t> composites_;
+
+  // overlays the composites were made with
+  Fl_SVG_Image *composite_link_ = NULL;
+  Fl_SVG_Image *composite_lock_ = NULL;
+
+  // selection state, indexed by Row_t::id, so sorting
+  // the rows doesn't need to touch it
+  std::vector<bool> selected_;
+  uint32_t next_id_ = 0;
+
+  // row of each id, -1 for ids that are gone
+  std::vector<int> row_of_id_;
+  size_t selected_count_ = 0;
+
+  // row where the last click without shift happened
+  int select_anchor_ = -1;
+
+  bool multi_select_ = false;
+
+  // recursive directory sizes that were asked for, by row id
+  typedef struct {
+    std::string path;
+    long mtime;
+    dirsize::result_t r;
+  } du_row_t;
+
+  dirsize *du_ = NULL;
+  std::unordered_map<uint32_t, du_row_t> du_rows_;
+
+  // huge directory mode: subdirectories are counted in the
+  // background once they become visible
+  dircount *counts_ = NULL;
+
+  // optional thumbnails of image files and the ones
+  // found for the rows visible in the last draw()
+  thumbnailer *thumbs_ = NULL;
+  std::vector<Fl_RGB_Image *> visible_thumbs_;
+  int visible_thumbs_top_ = 0;
+
+  // grid view: each table row is a line of "grid_cols_" entries
+  // in the current sort order, so Fl_Table only lays out and
+  // draws the visible lines
+  bool grid_ = false;
+  int grid_cols_ = 1;
+  int grid_icon_size_ = 64;
+
+  // list view row height and column widths to restore
+  int list_row_h_ = 25;
+  int list_col_w_[COL_MAX] = {0};
+
+  // icons rasterized at the grid icon size
+  typedef struct {
+    Fl_SVG_Image *svg;
+    Fl_SVG_Image *big;
+  } grid_icon_t;
+
+  std::vector<grid_icon_t> grid_icons_;
+
   // whether to check for icons when draw() is called
   bool check_icons_ = true;
 
@@ -300,18 +434,33 @@ private:
     within_double_click_timelimit_ = false;
   }
 
-  void blend_h(int i) {
-    if (i == blend_h_) return;
-    blend_h_ = i;
-    update_overlays();
-  }
-
-  int blend_h() const { return blend_h_; }
-
 protected:
   std::string open_directory_;
   std::string selection_;
   std::vector<Row_t> rowdata_;
+
+  // instrumentation, see fltk::stats
+  stats *stats_ = NULL;
+  stats::clock::time_point load_start_;
+  bool paint_pending_ = false;
+  double format_ms_ = 0;
+  unsigned long format_calls_ = 0;
+
+  // incremented by every load_dir(); a load that finds another value
+  // after handling pending events was overtaken by a newer one;
+  // atomic because worker threads compare it, too
+  std::atomic<unsigned> gen_ = { 0 };
+
+  // a load_dir() is reading a directory; calls made by the events it
+  // handles meanwhile only leave their directory in pending_dir_
+  bool loading_ = false;
+  bool pending_load_ = false;
+  std::string pending_dir_;
+
+  // handle pending events every this many entries while a
+  // directory is read; 0 turns it off
+  ulong check_events_ = 4096;
+
   int last_row_clicked_ = -1;
   Fl_SVG_Image *svg_link_ = NULL;
   Fl_SVG_Image *svg_noaccess_ = NULL;
@@ -327,25 +476,28 @@ protected:
 
   // create an overlay image, transitioning from the left being full
   // transparent to the right being full opaque
-  Fl_RGB_Image *make_overlay_image(uchar r, uchar g, uchar b, int W, int H)
+  static Fl_RGB_Image *make_overlay_image(Fl_Color c, int W, int H)
   {
     if (W < 1 || H < 1) return NULL;
 
-    uchar line[W*4];
-    uchar *data = new uchar[W*H*4];
-    const double div = static_cast<double>(sizeof(line)) / 255.0;
+    uchar r=0, g=0, b=0;
+    Fl::get_color(c, r, g, b);
+
+    const size_t line = W*4;
+    uchar *data = new uchar[line*H];
 
     // create a 1 pixel height line
-    for (size_t i=0; i < sizeof(line); i+=4) {
-      line[i] = r;
-      line[i+1] = g;
-      line[i+2] = b;
-      line[i+3] = static_cast<uchar>(static_cast<double>(i)/div);
+    for (int x=0; x < W; ++x) {
+      uchar *p = data + x*4;
+      p[0] = r;
+      p[1] = g;
+      p[2] = b;
+      p[3] = static_cast<uchar>(x*255 / W);
     }
 
     // copy the line multiple times
-    for (int i=0; i < H; ++i) {
-      memcpy(data + i*sizeof(line), line, sizeof(line));
+    for (int y=1; y < H; ++y) {
+      memcpy(data + y*line, data, line);
     }
 
     Fl_RGB_Image *rgba = new Fl_RGB_Image(data, W, H, 4);
@@ -354,21 +506,474 @@ protected:
     return rgba;
   }
 
-  // wrapper taking an Fl_Color argument
-  Fl_RGB_Image *make_overlay_image(Fl_Color c, int W, int H)
+  // return a cached overlay image or NULL
+  Fl_RGB_Image *overlay_image(Fl_Color c, int H) const
   {
-    if (W < 1 || H < 1) return NULL;
-    uchar r=0, g=0, b=0;
-    Fl::get_color(c, r, g, b);
-    return make_overlay_image(r, g, b, W, H);
+    for (const auto &e : fade_cache_) {
+      if (e.color == c && e.w == blend_w() && e.h == H) {
+        return e.img;
+      }
+    }
+
+    return NULL;
+  }
+
+  // make sure the overlay images for rows of height H are cached
+  void update_overlays(int H)
+  {
+    const Fl_Color col[2] = { color(), selection_color() };
+
+    for (const Fl_Color c : col) {
+      if (overlay_image(c, H)) continue;
+
+      Fl_RGB_Image *img = make_overlay_image(c, blend_w(), H);
+      if (!img) continue;
+
+      // drop the oldest entry
+      if (fade_cache_.size() >= FADE_CACHE_MAX) {
+        delete fade_cache_.front().img;
+        fade_cache_.erase(fade_cache_.begin());
+      }
+
+      fade_cache_.push_back({ c, blend_w(), H, img });
+    }
+  }
+
+  void clear_overlays()
+  {
+    for (const auto &e : fade_cache_) {
+      delete e.img;
+    }
+
+    fade_cache_.clear();
+  }
+
+  // FNV-1a, used to look up the ids of the previous listing by filename
+  struct name_hash {
+    size_t operator() (const char *s) const {
+      size_t h = 14695981039346656037ULL;
+      while (*s) h = (h ^ static_cast<unsigned char>(*s++)) * 1099511628211ULL;
+      return h;
+    }
+  };
+
+  struct name_equal {
+    bool operator() (const char *a, const char *b) const {
+      return strcmp(a, b) == 0;
+    }
+  };
+
+  // current row index of an id or -1
+  int row_index(uint32_t id) const {
+    return (id < row_of_id_.size()) ? row_of_id_[id] : -1;
+  }
+
+  // map the ids to their rows; must be called whenever
+  // the order of rowdata_ changed
+  void index_rows()
+  {
+    row_of_id_.assign(next_id_, -1);
+
+    for (size_t i = 0; i < rowdata_.size(); ++i) {
+      row_of_id_[rowdata_[i].id] = static_cast<int>(i);
+    }
+  }
+
+  uint32_t row_id(int R) const {
+    return (R >= 0 && R < static_cast<int>(rowdata_.size())) ? rowdata_[R].id : ID_NONE;
+  }
+
+  // free the strings of a row
+  static void free_row(const Row_t &e)
+  {
+    if (e.label) free(e.label);
+
+    for (int i = 0; i < COL_MAX; ++i) {
+      if (e.cols[i] && (i != COL_TYPE || e.type == ENTRY_ALLOCATED)) {
+        free(e.cols[i]);
+      }
+    }
+  }
+
+  // entry shown in a table cell or -1; in list view
+  // this is the table row, in grid view it's line by line
+  int item_index(int R, int C) const
+  {
+    const int i = grid_ ? R * grid_cols_ + C : R;
+    return (R >= 0 && C >= 0 && i < static_cast<int>(rowdata_.size())) ? i : -1;
+  }
+
+  // damage the cells of an entry
+  void redraw_item(int i)
+  {
+    if (grid_) {
+      redraw_range(i / grid_cols_, i / grid_cols_, i % grid_cols_, i % grid_cols_);
+    } else {
+      redraw_range(i, i, 0, cols() - 1);
+    }
+  }
+
+  // first entry on the topmost visible line
+  int top_item() {
+    return grid_ ? row_position() * grid_cols_ : row_position();
+  }
+
+  // scroll an entry to the top
+  void show_item(int i) {
+    row_position(grid_ ? i / grid_cols_ : i);
+  }
+
+  int grid_cell_w() const { return grid_icon_size_ + 2*labelsize(); }
+  int grid_cell_h() const { return grid_icon_size_ + 3*labelsize() + 8; }
+
+  // set the lines and columns of the table for the current view
+  void update_layout()
+  {
+    if (!grid_) {
+      cols(COL_MAX);
+      rows(rowdata_.size());
+      return;
+    }
+
+    // always leave room for the scrollbar, or else the number of
+    // columns would change when the scrollbar shows up
+    const int avail = w() - Fl::box_dw(box()) - vscrollbar->w();
+    grid_cols_ = std::max(1, avail / grid_cell_w());
+
+    cols(grid_cols_);
+    col_width_all(std::max(grid_cell_w(), avail / grid_cols_));
+    rows((rowdata_.size() + grid_cols_ - 1) / grid_cols_);
+    row_height_all(grid_cell_h());
+  }
+
+  // return the icon rasterized at the grid icon size or NULL if
+  // prepare_grid_icon() wasn't called for it yet
+  Fl_SVG_Image *grid_icon(Fl_SVG_Image *svg) const
+  {
+    if (!svg) return NULL;
+
+    for (const auto &e : grid_icons_) {
+      if (e.svg == svg) return e.big;
+    }
+
+    return NULL;
+  }
+
+  void prepare_grid_icon(Fl_SVG_Image *svg)
+  {
+    if (!svg || grid_icon(svg)) return;
+
+    // copy() shares the parsed SVG data with the original image
+    Fl_SVG_Image *big = static_cast<Fl_SVG_Image *>(svg->copy(grid_icon_size_, grid_icon_size_));
+    big->proportional = false;
+    big->normalize();
+    grid_icons_.push_back({ svg, big });
+  }
+
+  void clear_grid_icons()
+  {
+    for (const auto &e : grid_icons_) {
+      delete e.big;
+    }
+
+    grid_icons_.clear();
+  }
+
+  // change the selection state of a row and damage it if needed
+  void set_selected(int R, bool val)
+  {
+    const uint32_t id = rowdata_.at(R).id;
+    if (selected_[id] == val) return;
+
+    selected_[id] = val;
+    selected_count_ += val ? 1 : -1;
+    redraw_item(R);
+  }
+
+  // update the selection after a click on a row
+  void click_select(int R)
+  {
+    const bool ctrl = multi_select_ && Fl::event_state(FL_CTRL);
+    const bool shift = multi_select_ && Fl::event_state(FL_SHIFT) && select_anchor_ >= 0 &&
+      select_anchor_ < static_cast<int>(rowdata_.size());
+
+    if (shift) {
+      // select range from the anchor, keep the anchor
+      if (!ctrl) clear_selection();
+
+      for (int i = std::min(R, select_anchor_); i <= std::max(R, select_anchor_); ++i) {
+        set_selected(i, true);
+      }
+    } else if (ctrl) {
+      set_selected(R, !entry_selected(R));
+      select_anchor_ = R;
+    } else {
+      if (selected_count_ > 1 || !entry_selected(R)) clear_selection();
+      set_selected(R, true);
+      select_anchor_ = R;
+    }
+  }
+
+  // update the selection while the mouse is dragged over a row; the
+  // range from the anchor is selected if multiple entries can be
+  // selected, otherwise the selection follows the mouse
+  void drag_select(int R)
+  {
+    if (multi_select_ && select_anchor_ >= 0 && select_anchor_ < static_cast<int>(rowdata_.size())) {
+      const int lo = std::min(R, select_anchor_);
+      const int hi = std::max(R, select_anchor_);
+
+      if (!Fl::event_state(FL_CTRL)) {
+        for (int i = 0; i < static_cast<int>(rowdata_.size()); ++i) {
+          if (i < lo || i > hi) set_selected(i, false);
+        }
+      }
+
+      for (int i = lo; i <= hi; ++i) {
+        set_selected(i, true);
+      }
+    } else if (selected_count_ > 1 || !entry_selected(R)) {
+      clear_selection();
+      set_selected(R, true);
+      select_anchor_ = R;
+    }
+  }
+
+  // move the focus with the arrow keys, Home and End and select the
+  // entry; with shift the range from the anchor is selected, like when
+  // dragging; in grid view up and down move by a whole line; returns
+  // false if the key isn't used for navigation
+  bool key_select(int key)
+  {
+    const int n = static_cast<int>(rowdata_.size());
+    const int step = grid_ ? grid_cols_ : 1;
+    const int cur = (last_row_clicked_ >= 0 && last_row_clicked_ < n) ? last_row_clicked_ : -1;
+    int i;
+
+    switch (key) {
+      case FL_Up:
+        i = (cur == -1) ? 0 : (cur - step >= 0) ? cur - step : cur;
+        break;
+      case FL_Down:
+        i = (cur == -1) ? 0 : (cur + step < n) ? cur + step : cur;
+        break;
+      case FL_Left:
+        if (!grid_) return false;
+        i = std::max(cur - 1, 0);
+        break;
+      case FL_Right:
+        if (!grid_) return false;
+        i = (cur == -1) ? 0 : std::min(cur + 1, n - 1);
+        break;
+      case FL_Home:
+        i = 0;
+        break;
+      case FL_End:
+        i = n - 1;
+        break;
+      default:
+        return false;
+    }
+
+    if (n == 0) return true;
+
+    if (multi_select_ && Fl::event_state(FL_SHIFT)) {
+      drag_select(i);
+    } else {
+      if (cur != -1 && selected_count_ == 1 && entry_selected(cur)) {
+        set_selected(cur, false);
+      } else {
+        clear_selection();
+      }
+      set_selected(i, true);
+      select_anchor_ = i;
+    }
+
+    last_row_clicked_ = i;
+    within_double_click_timelimit_ = false;
+
+    // scroll only as far as needed to show the entry
+    const int line = grid_ ? i / grid_cols_ : i;
+    int r1, r2, c1, c2;
+    visible_cells(r1, r2, c1, c2);
+
+    if (line <= r1) {
+      row_position(line);
+    } else if (line >= r2) {
+      row_position(std::max(0, line - (r2 - r1) + 1));
+    }
+
+    return true;
+  }
+
+  // look up the thumbnails of the visible entries and request the missing ones
+  void update_thumbnails(int r1, int r2)
+  {
+    std::vector<thumbnailer::file_t> files;
+
+    visible_thumbs_.assign(std::max(0, r2 - r1 + 1), NULL);
+    visible_thumbs_top_ = r1;
+
+    for (int r = r1; r <= r2; ++r) {
+      const Row_t &row = rowdata_.at(r);
+
+      if (row.type != 'R' || !thumbnailer::supported(row.cols[COL_NAME])) {
+        continue;
+      }
+
+      const std::string path = entry_path(r);
+      Fl_RGB_Image *img = thumbs_->get(path, row.last_mod);
+
+      if (img) {
+        visible_thumbs_[r - r1] = img;
+      } else {
+        files.push_back({ path, row.last_mod });
+      }
+    }
+
+    thumbs_->request(files);
   }
 
-  void update_overlays()
+  Fl_RGB_Image *visible_thumbnail(int R) const
   {
-    if (icon_blend_[0]) delete icon_blend_[0];
-    if (icon_blend_[1]) delete icon_blend_[1];
-    icon_blend_[0] = make_overlay_image(color(), blend_w(), blend_h());
-    icon_blend_[1] = make_overlay_image(selection_color(), blend_w(), blend_h());
+    const int i = R - visible_thumbs_top_;
+    return (i >= 0 && i < static_cast<int>(visible_thumbs_.size())) ? visible_thumbs_[i] : NULL;
+  }
+
+  // new thumbnails are ready
+  static void thumbnails_cb(void *v)
+  {
+    filetable_ *o = static_cast<filetable_ *>(v);
+    const int n = static_cast<int>(o->visible_thumbs_.size());
+    const int first = o->visible_thumbs_top_;
+    const int last = first + n - 1;
+
+    if (n == 0) {
+      return;
+    } else if (o->grid_) {
+      o->redraw_range(first / o->grid_cols_, last / o->grid_cols_, 0, o->grid_cols_ - 1);
+    } else {
+      o->redraw_range(first, last, COL_NAME, COL_NAME);
+    }
+  }
+
+  // ask for the number of entries of the visible directories
+  // that weren't counted yet
+  void update_counts(int r1, int r2)
+  {
+    std::vector<dircount::job_t> jobs;
+
+    for (int r = r1; r <= r2; ++r) {
+      const Row_t &row = rowdata_.at(r);
+
+      if (row.bytes == BYTES_UNCOUNTED && row.isdir()) {
+        jobs.push_back({ row.id, entry_path(r) });
+      }
+    }
+
+    if (!counts_) {
+      if (jobs.empty()) return;
+      counts_ = new dircount();
+      counts_->callback(counts_cb, this);
+    }
+
+    counts_->request(jobs, show_hidden());
+  }
+
+  // new directory counts are known
+  static void counts_cb(void *v)
+  {
+    filetable_ *o = static_cast<filetable_ *>(v);
+    std::vector<dircount::result_t> done;
+
+    o->counts_->take(done);
+
+    for (const auto &c : done) {
+      const int i = o->row_index(c.id);
+
+      if (i != -1 && o->rowdata_[i].bytes == BYTES_UNCOUNTED) {
+        o->rowdata_[i].bytes = c.count;
+        o->redraw_item(i);
+      }
+    }
+  }
+
+  // new directory sizes are known
+  static void dir_sizes_cb(void *v)
+  {
+    filetable_ *o = static_cast<filetable_ *>(v);
+
+    for (auto &e : o->du_rows_) {
+      o->du_->get(e.second.path, e.second.mtime, e.second.r);
+    }
+
+    o->redraw();
+  }
+
+  // return the icon blended with the link and/or lock overlay;
+  // each variant is blended only once and kept until the icons change;
+  // returns NULL if there's nothing to draw on top or if the
+  // images can't be blended (i.e. different sizes)
+  Fl_RGB_Image *composite_icon(Fl_SVG_Image *svg, bool link, bool lock)
+  {
+    if (!svg_link_) link = false;
+    if (!svg_noaccess_) lock = false;
+    if (!svg || (!link && !lock)) return NULL;
+
+    if (svg_link_ != composite_link_ || svg_noaccess_ != composite_lock_) {
+      clear_composites();
+      composite_link_ = svg_link_;
+      composite_lock_ = svg_noaccess_;
+    }
+
+    const int idx = (link && lock) ? 2 : (lock ? 1 : 0);
+    composite_t *comp = NULL;
+
+    for (auto &e : composites_) {
+      if (e.svg == svg) {
+        comp = &e;
+        break;
+      }
+    }
+
+    if (!comp) {
+      composite_t e = { svg, {0} };
+      composites_.push_back(e);
+      comp = &composites_.back();
+    }
+
+    // the icon was resized since it was blended
+    Fl_RGB_Image *&rgb = comp->rgb[idx];
+
+    if (rgb && (rgb->w() != svg->w() || rgb->h() != svg->h())) {
+      delete rgb;
+      rgb = NULL;
+    }
+
+    // a failed blend isn't remembered, the images may not be
+    // rasterized yet or have different sizes only for now;
+    // the checks in blend_rgba() are cheap
+    if (!rgb) {
+      // same order as drawing them on top of each other: link, then lock
+      rgb = blend_rgba(svg, link ? svg_link_ : svg_noaccess_,
+                       (link && lock) ? svg_noaccess_ : NULL);
+    }
+
+    return rgb;
+  }
+
+  // delete all pre-blended and grid sized icons; call this whenever
+  // the icons were changed
+  void clear_composites()
+  {
+    for (const auto &e : composites_) {
+      for (int i=0; i < 3; ++i) {
+        if (e.rgb[i]) delete e.rgb[i];
+      }
+    }
+
+    composites_.clear();
+    clear_grid_icons();
   }
 
   // format localization string using "{}" as replacement for a variable:
@@ -398,6 +1003,87 @@ protected:
     return s;
   }
 
+  // split the size labels at their "%ld" or "%.1Lf" conversion;
+  // labels using other conversions fall back to snprintf()
+  void compile_filesize_labels()
+  {
+    const struct lconv *lc = localeconv();
+    decimal_point_ = (lc && !empty(lc->decimal_point)) ? lc->decimal_point : ".";
+
+    for (int i = 0; i < STR_SIZE_MAX; ++i) {
+      const bool is_long = (i == STR_SIZE_ELEMENTS || i == STR_SIZE_BYTES);
+      const char *spec = is_long ? FLTK_FMT_LONG : FLTK_FMT_FLOAT;
+      const bool is_default = is_long ? (strcmp(FLTK_FMT_LONG, "%ld") == 0)
+                                      : (strcmp(FLTK_FMT_FLOAT, "%.1Lf") == 0);
+
+      for (int iec = 0; iec < 2; ++iec) {
+        const std::string &l = filesize_label_[i][iec];
+        size_tmpl_t &t = filesize_tmpl_[i][iec];
+        const size_t pos = l.find(spec);
+
+        t.fast = (is_default && pos != std::string::npos && l.find('%') == pos &&
+                  l.find('%', pos + strlen(spec)) == std::string::npos);
+
+        if (t.fast) {
+          t.pre = l.substr(0, pos);
+          t.post = l.substr(pos + strlen(spec));
+        }
+      }
+    }
+  }
+
+  // write a precompiled size label with the number "n" and one decimal
+  // place "tenths" (-1 for none) into "buf"; returns the full length
+  int format_label(char *buf, size_t size, EStrSize idx, bool iec, long n, int tenths) const
+  {
+    const size_tmpl_t &t = filesize_tmpl_[idx][iec];
+
+    if (!t.fast) {
+      return snprintf(buf, size, filesize_label_[idx][iec].c_str(), n);
+    }
+
+    char num[48];
+    char digits[24];
+    size_t len = 0;
+    int nd = 0;
+    ulong u = (n < 0) ? -static_cast<ulong>(n) : static_cast<ulong>(n);
+
+    do {
+      digits[nd++] = '0' + (u % 10);
+      u /= 10;
+    } while (u > 0);
+
+    if (n < 0) num[len++] = '-';
+    while (nd > 0) num[len++] = digits[--nd];
+
+    if (tenths >= 0) {
+      for (size_t i = 0; i < decimal_point_.size() && i < 8; ++i) {
+        num[len++] = decimal_point_[i];
+      }
+      num[len++] = '0' + tenths;
+    }
+
+    // copy "pre", "num" and "post", truncating like snprintf()
+    size_t total = 0;
+
+    auto append = [&] (const char *str, size_t l) {
+      if (size > 0 && total < size - 1) {
+        memcpy(buf + total, str, std::min(l, size - 1 - total));
+      }
+      total += l;
+    };
+
+    append(t.pre.data(), t.pre.size());
+    append(num, len);
+    append(t.post.data(), t.post.size());
+
+    if (size > 0) {
+      buf[std::min(total, size - 1)] = 0;
+    }
+
+    return static_cast<int>(total);
+  }
+
   // return a generic SVG icon by idx/enum
   static const char *default_icon_data(EIcn idx)
   {
@@ -425,27 +1111,87 @@ protected:
     return NULL;
   }
 
-  // after initially calling Fl_Table_Row::draw() we
-  // need to check rowdata_ for icons and call it again
-  // to update the cells if any icons were found;
-  // this should be done whenever load_dir() was called,
-  // so make sure to set "check_icons_ = true" when you
-  // clear the current table
+  // range of the entries that are visible; "last" is smaller
+  // than "first" if there are none
+  void visible_items(int &first, int &last)
+  {
+    int r1 = 0, r2 = -1, c1 = 0, c2 = 0;
+
+    if (rows() > 0) {
+      visible_cells(r1, r2, c1, c2);
+      r1 = std::max(r1, 0);
+      r2 = std::min(r2, static_cast<int>(rows()) - 1);
+    }
+
+    if (grid_) {
+      // visible lines to visible entries
+      r1 *= grid_cols_;
+      r2 = std::min((r2 + 1) * grid_cols_, static_cast<int>(rowdata_.size())) - 1;
+    }
+
+    first = r1;
+    last = r2;
+  }
+
+  // the width of the icon column is measured before drawing,
+  // whenever load_dir() was called, so make sure to set
+  // "check_icons_ = true" when you clear the current table
   void draw()
   {
-    Fl_Table_Row::draw();
+    if (check_icons_) {
+      check_icons_ = false;
+      col_name_extra_w_ = thumbs_ ? labelsize() + 10 : 2;
 
-    if (!check_icons_) return;
-    //printf("looking for icons\n");
+      // stop at the first row that has an icon
+      for (auto &e : rowdata_) {
+        if (!e.svg) e.svg = icon(e);
 
-    check_icons_ = false;
-    col_name_extra_w_ = 2;
+        if (e.svg) {
+          col_name_extra_w_ = labelsize() + 10;
+          break;
+        }
+      }
+    }
 
-    for (const auto &e : rowdata_) {
-      if (e.svg) {
-        col_name_extra_w_ = labelsize() + 10;
-        Fl_Table_Row::draw();
-        return;
+    int r1, r2;
+    visible_items(r1, r2);
+
+    if (grid_) {
+      // get the large icons of all visible entries ready
+      for (int i = r1; i <= r2; ++i) {
+        Row_t &row = rowdata_.at(i);
+        if (!row.svg) row.svg = icon(row);
+        prepare_grid_icon(row.svg);
+      }
+
+      prepare_grid_icon(svg_link_);
+      prepare_grid_icon(svg_noaccess_);
+    } else if (blend_w() > 0) {
+      // get the overlay images of all visible rows ready
+      int last_h = -1;
+
+      for (int r = r1; r <= r2; ++r) {
+        if (row_height(r) == last_h) continue;
+        last_h = row_height(r);
+        update_overlays(last_h);
+      }
+    }
+
+    if (thumbs_) update_thumbnails(r1, r2);
+    if (huge_mode() && !rowdata_.empty()) update_counts(r1, r2);
+
+    Fl_Table_Row::draw();
+
+    if (stats_) {
+      if (format_calls_ > 0) {
+        stats_->add(stats::FORMAT, format_ms_, format_calls_);
+        format_ms_ = 0;
+        format_calls_ = 0;
+      }
+
+      if (paint_pending_) {
+        paint_pending_ = false;
+        stats_->record(stats::FIRST_PAINT, load_start_);
       }
     }
   }
@@ -453,6 +1199,11 @@ protected:
   // Handle drawing all cells in table
   void draw_cell(TableContext context, int R=0, int C=0, int X=0, int Y=0, int W=0, int H=0)
   {
+    if (grid_ && context == CONTEXT_CELL) {
+      draw_grid_cell(R, C, X, Y, W, H);
+      return;
+    }
+
     if (C >= COL_MAX) {
       return;
     }
@@ -487,17 +1238,26 @@ protected:
         fl_push_clip(X, Y, W, H); {
           Fl_Color bgcol = color();
           Fl_Align al = (C == COL_SIZE) ? FL_ALIGN_RIGHT : FL_ALIGN_LEFT;
-          Fl_RGB_Image *blend = icon_blend_[0];
 
-          if (row_selected(R)) {
-            blend = icon_blend_[1];
+          if (entry_selected(R)) {
             bgcol = selection_color();
             //draw_focus() ???
           }
 
+          const char *label;
+
+          if (stats_) {
+            const auto start = stats::clock::now();
+            label = cell_text(rowdata_.at(R), C);
+            format_ms_ += std::chrono::duration<double, std::milli>(stats::clock::now() - start).count();
+            format_calls_++;
+          } else {
+            label = cell_text(rowdata_.at(R), C);
+          }
+
           int fw = 0;
           int fh = 0;
-          fl_measure(rowdata_.at(R).cols[C], fw, fh, 0);
+          fl_measure(label, fw, fh, 0);
 
           if (C == COL_SIZE && fw > W) {
             al = FL_ALIGN_LEFT;
@@ -507,7 +1267,6 @@ protected:
           fl_rectf(X, Y, W, H, bgcol);
 
           // Icon and label
-          const char *label = rowdata_.at(R).cols[C];
 
           if (C == COL_NAME) {
             if (rowdata_.at(R).label) {
@@ -518,16 +1277,27 @@ protected:
               rowdata_.at(R).svg = icon(rowdata_.at(R));
             }
 
-            if (rowdata_.at(R).svg) {
-              rowdata_.at(R).svg->draw(X + 2, Y + 2);
-            }
-
-            if (rowdata_.at(R).is_link && svg_link_) {
-              svg_link_->draw(X + 2, Y + 2);
-            }
-
-            if (rowdata_.at(R).bytes == -1 && svg_noaccess_) {
-              svg_noaccess_->draw(X + 2, Y + 2);
+            Fl_RGB_Image *thumb = visible_thumbnail(R);
+            Fl_RGB_Image *comp = thumb ? NULL : composite_icon(rowdata_.at(R).svg,
+              rowdata_.at(R).is_link, rowdata_.at(R).bytes == -1);
+
+            if (thumb) {
+              thumb->scale(labelsize() + 4, labelsize() + 4, 1, 0);
+              thumb->draw(X + 2, Y + 2);
+            } else if (comp) {
+              comp->draw(X + 2, Y + 2);
+            } else {
+              if (rowdata_.at(R).svg) {
+                rowdata_.at(R).svg->draw(X + 2, Y + 2);
+              }
+
+              if (rowdata_.at(R).is_link && svg_link_) {
+                svg_link_->draw(X + 2, Y + 2);
+              }
+
+              if (rowdata_.at(R).bytes == -1 && svg_noaccess_) {
+                svg_noaccess_->draw(X + 2, Y + 2);
+              }
             }
 
             X += col_name_extra_w_;
@@ -541,9 +1311,9 @@ protected:
 
           // blend over long text at the end of name column
           if (C == COL_NAME && blend_w() > 0) {
-            if (blend_h() != H) blend_h(H);
+            Fl_RGB_Image *blend = overlay_image(bgcol, H);
 
-            if (blend && fw + blend_h() > W) {
+            if (blend && fw + H > W) {
               blend->draw(X + W - col_name_extra_w_ - blend_w(), Y);
             }
           }
@@ -556,21 +1326,67 @@ protected:
     }
   }
 
+  // draw an entry of the grid view: icon or thumbnail on
+  // top, name centered below and wrapped to two lines
+  void draw_grid_cell(int R, int C, int X, int Y, int W, int H)
+  {
+    const int i = item_index(R, C);
+    Fl_Color bgcol = color();
+
+    fl_push_clip(X, Y, W, H);
+
+    if (i == -1) {
+      // empty cells on the last line
+      fl_rectf(X, Y, W, H, bgcol);
+      fl_pop_clip();
+      return;
+    }
+
+    Row_t &row = rowdata_.at(i);
+
+    if (entry_selected(i)) {
+      bgcol = selection_color();
+    }
+
+    fl_rectf(X, Y, W, H, bgcol);
+
+    const int sz = grid_icon_size_;
+    const int ix = X + (W - sz)/2;
+    const int iy = Y + 4;
+    Fl_RGB_Image *thumb = visible_thumbnail(i);
+    Fl_SVG_Image *img;
+
+    if (thumb) {
+      thumb->scale(sz, sz, 1, 0);
+      thumb->draw(ix + (sz - thumb->w())/2, iy + (sz - thumb->h())/2);
+    } else {
+      if ((img = grid_icon(row.svg)) != NULL) img->draw(ix, iy);
+      if (row.is_link && (img = grid_icon(svg_link_)) != NULL) img->draw(ix, iy);
+      if (row.bytes == -1 && (img = grid_icon(svg_noaccess_)) != NULL) img->draw(ix, iy);
+    }
+
+    fl_font(labelfont(), labelsize());
+    fl_color(fl_contrast(labelcolor(), bgcol));
+    fl_draw(row.label ? row.label : row.cols[COL_NAME], X + 2, iy + sz + 2, W - 4, H - sz - 8,
+            FL_ALIGN_TOP | FL_ALIGN_WRAP | FL_ALIGN_CLIP, NULL, 0);
+
+    fl_pop_clip();
+  }
+
   // Sort a column up or down
   void sort_column(int col)
   {
-    // save current selection state in rowdata_
-    for (size_t i = 0; i < rows(); ++i) {
-      rowdata_.at(i).selected = row_selected(i) ? true : false;
-    }
+    stats::scope sc(stats_, stats::SORT);
+    const uint32_t focus = row_id(last_row_clicked_);
+    const uint32_t anchor = row_id(select_anchor_);
 
-    // sort data while preserving order between equal elements
+    // sort data while preserving order between equal elements;
+    // the selection is stored by row id and moves along
     std::stable_sort(rowdata_.begin(), rowdata_.end(), sort(col, sort_reverse_, sort_mode()));
+    index_rows();
 
-    // update table row selection from rowdata_
-    for (size_t i = 0; i < rows(); ++i) {
-      select_row(i, rowdata_.at(i).selected);
-    }
+    last_row_clicked_ = row_index(focus);
+    select_anchor_ = row_index(anchor);
 
     redraw();
   }
@@ -604,25 +1420,70 @@ protected:
   {
     if (e == FL_NO_EVENT) return 0;
 
+    // Fl_Table's own cursor keys would only move its cell cursor
+    if (e == FL_KEYBOARD && key_select(Fl::event_key())) return 1;
+
     int ret = Fl_Table_Row::handle(e);
     reserve_entries_ = 0;
 
+    // hovering never changes the table; Fl_Table_Row already
+    // took care of the column resize cursor
+    if (e == FL_MOVE || e == FL_ENTER || e == FL_LEAVE) {
+      return ret;
+    }
+
+    if (e == FL_PUSH && Fl::event_button() == FL_LEFT_MOUSE) {
+      int R = -1, C = -1;
+      ResizeFlag rf = RESIZE_NONE;
+
+      if (cursor2rowcol(R, C, rf) == CONTEXT_CELL && rf == RESIZE_NONE) {
+        const int i = item_index(R, C);
+        if (i != -1) click_select(i); else clear_selection();
+      }
+    } else if (e == FL_DRAG && Fl::event_state(FL_BUTTON1) && !is_interactive_resize()) {
+      int R = -1, C = -1;
+      ResizeFlag rf = RESIZE_NONE;
+
+      if (cursor2rowcol(R, C, rf) == CONTEXT_CELL) {
+        const int i = item_index(R, C);
+        if (i != -1) drag_select(i);
+      }
+    } else if (e == FL_KEYBOARD && multi_select_ && Fl::event_state(FL_CTRL) && Fl::event_key() == 'a') {
+      select_all();
+      return 1;
+    }
+
     switch (callback_context()) {
       case CONTEXT_CELL:
         if (e == FL_RELEASE) {
-          if (dc_timeout_ == 0) {   // double click was disabled
-            reserve_entries_ = rowdata_.at(last_row_clicked_).bytes;
+          const int item = item_index(callback_row(), callback_col());
+
+          if (item == -1) {
+            // empty cell on the last line of the grid view
+            last_row_clicked_ = -1;
+          } else if (dc_timeout_ == 0) {   // double click was disabled
+            last_row_clicked_ = item;
+            reserve_entries_ = std::max(rowdata_.at(last_row_clicked_).bytes, 0L);
+
+            // load_dir() handles events, which may delete this widget
+            Fl_Widget_Tracker tracker(this);
             double_click_callback();
-          } else if (last_row_clicked_ == callback_row() && within_double_click_timelimit_) {  // double click
+            if (tracker.deleted()) return 1;
+            redraw();
+          } else if (last_row_clicked_ == item && within_double_click_timelimit_) {  // double click
             Fl::remove_timeout(reset_timelimit_cb);
             within_double_click_timelimit_ = false;
-            reserve_entries_ = rowdata_.at(last_row_clicked_).bytes;
+            reserve_entries_ = std::max(rowdata_.at(last_row_clicked_).bytes, 0L);
+
+            Fl_Widget_Tracker tracker(this);
             double_click_callback();
+            if (tracker.deleted()) return 1;
+            redraw();
           } else {
             Fl::remove_timeout(reset_timelimit_cb);
             within_double_click_timelimit_ = true;
             Fl::add_timeout(dc_timeout_, reset_timelimit_cb);
-            last_row_clicked_ = callback_row();
+            last_row_clicked_ = item;
             DEBUG_PRINT("(CONTEXT_CELL) last_row_clicked_ set to %d\n", last_row_clicked_);
           }
 
@@ -635,7 +1496,7 @@ protected:
 
       case CONTEXT_TABLE:
         // "outside" area -> clear selection
-        select_all_rows(0);
+        clear_selection();
         last_row_clicked_ = -1;
         DEBUG_PRINT("%s\n", "(CONTEXT_TABLE) last_row_clicked_ set to -1");
 
@@ -651,7 +1512,8 @@ protected:
         break;
     }
 
-    redraw();
+    // selection changes were already damaged row by row by
+    // set_selected(), so there's no need to redraw everything
 
     return ret;
   }
@@ -693,52 +1555,157 @@ protected:
     return buf;
   }
 
-  char *count_dir_entries(long &count, const char *directory)
+  // return the number of entries of a subdirectory
+  // of open_directory_ or -1 on error
+  long count_dir_entries(const char *directory)
+  {
+    if (empty(directory)) {
+      return -1;
+    }
+
+    std::string temp;
+    temp.reserve(open_directory_.size() + strlen(directory) + 1);
+    temp = open_directory_ + "/" + directory;
+
+    return count_dir_entries_at(AT_FDCWD, temp.c_str());
+  }
+
+  // same as above for a subdirectory of the open directory "fd"
+  long count_dir_entries_at(int fd, const char *directory)
   {
-    DIR *d;
-    struct dirent *dir;
+    long count = 0;
 
     if (empty(directory)) {
-      count = -1;
-      return NULL;
+      return -1;
+    }
+
+    stats::scope sc(stats_, stats::COUNT);
+
+    const int sub = openat(fd, directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    auto sink = [&count] (const dirscan::entry_t &) { count++; };
+
+    if (!dirscan::scan(sub, show_hidden(), dirscan::NAMES_ONLY, sink)) {
+      return -1;
+    }
+
+    return count;
+  }
+
+  // look up or create a cache slot; returns NULL on a cache miss
+  // and the slot to format into in "slot"
+  const char *fmt_cache_lookup(char type, long key, fmt_cache_t *&slot)
+  {
+    if (fmt_cache_.empty()) {
+      fmt_cache_.resize(FMT_CACHE_SLOTS);
+      fmt_cache_clear();
+    }
+
+    const ulong hash = (static_cast<ulong>(key) * 2654435761UL) ^ static_cast<ulong>(type);
+    slot = &fmt_cache_[(hash ^ (hash >> 16)) & (FMT_CACHE_SLOTS - 1)];
+
+    if (slot->type == type && slot->key == key) {
+      return slot->str;
+    }
+
+    slot->type = type;
+    slot->key = key;
+
+    return NULL;
+  }
+
+  // invalidate all formatted strings, i.e. after a label was changed
+  void fmt_cache_clear()
+  {
+    for (auto &e : fmt_cache_) {
+      e.type = 0;
+    }
+  }
+
+  // format a timestamp with a leading space, using the thread-safe
+  // localtime_r() and the locale-aware strftime(); returns "buf"
+  char *format_time(char *buf, size_t size, time_t t) const
+  {
+    struct tm tm;
+
+    if (size < 2) return buf;
+    buf[0] = ' ';
+
+    if (!localtime_r(&t, &tm) || strftime(buf + 1, size - 1, date_format_.c_str(), &tm) == 0) {
+      buf[1] = 0;
+    }
+
+    return buf;
+  }
+
+  // return the text of a cell; the size and date columns are formatted
+  // on demand and the result is only valid until the next call;
+  // directories that are still being counted are left empty, unless
+  // "count" is false (for measuring), which shows them as unknown
+  const char *cell_text(Row_t &r, int C, bool count=true)
+  {
+    fmt_cache_t *slot;
+    const char *p;
+
+    // no stat() information available
+    if (r.cols[C] || r.type == 0) {
+      return r.cols[C];
     }
 
-    { std::string temp;
-      temp.reserve(open_directory_.size() + strlen(directory) + 1);
-      temp = open_directory_ + "/" + directory;
+    switch (C) {
+      case COL_SIZE:
+        if (!r.isdir()) {
+          if ((p = fmt_cache_lookup('B', r.bytes, slot)) == NULL) {
+            p = human_readable_filesize(slot->str, FMT_CACHE_LEN, r.bytes);
+          }
+          return p;
+        }
 
-      if ((d = opendir(temp.c_str())) == NULL) {
-        count = -1;
-        return strdup(str_unknown_elements_.c_str());
-      }
-    }  // end temp
+        // recursive size instead of the number of entries
+        if (!du_rows_.empty()) {
+          auto it = du_rows_.find(r.id);
 
-    count = errno = 0;
+          if (it != du_rows_.end() && it->second.r.bytes >= 0) {
+            const dirsize::result_t &du = it->second.r;
 
-    while ((dir = readdir(d)) != NULL)
-    {
-      // handle hidden files
-      if (dir->d_name[0] == '.' && !show_hidden()) {
-        continue;
-      }
+            if ((p = fmt_cache_lookup(du.done ? 'B' : 'P', du.bytes, slot)) == NULL) {
+              p = human_readable_filesize(slot->str, FMT_CACHE_LEN - 4, du.bytes);
 
-      // no "." and ".." entries
-      if (show_hidden() && (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0)) {
-        continue;
-      }
+              // still counting
+              if (!du.done) {
+                size_t len = strlen(slot->str);
+                if (len > 0 && slot->str[len-1] == ' ') len--;
+                memcpy(slot->str + len, "... ", 5);
+              }
+            }
+            return p;
+          }
+        }
 
-      count++;
-    }
+        if (r.bytes == BYTES_UNCOUNTED) {
+          return count ? "" : str_unknown_elements_.c_str();
+        }
+
+        if (r.bytes < 0) {
+          return str_unknown_elements_.c_str();
+        }
+
+        if ((p = fmt_cache_lookup('E', r.bytes, slot)) == NULL) {
+          format_label(slot->str, FMT_CACHE_LEN, STR_SIZE_ELEMENTS, use_iec_, r.bytes, -1);
+          p = slot->str;
+        }
+        return p;
 
-    int errsv = errno;
-    closedir(d);
+      case COL_LAST_MOD:
+        if ((p = fmt_cache_lookup('T', r.last_mod, slot)) == NULL) {
+          p = format_time(slot->str, FMT_CACHE_LEN, r.last_mod);
+        }
+        return p;
 
-    if (errsv != 0 || count < 0) {
-      count = -1;
-      return strdup(str_unknown_elements_.c_str());
+      default:
+        break;
     }
 
-    return printf_alloc(filesize_label_[STR_SIZE_ELEMENTS][use_iec_].c_str(), count);
+    return r.cols[C];
   }
 
   // returns true if the current filename is accepted by the
@@ -786,12 +1753,35 @@ protected:
     }
   }
 
-  // automatically set column widths to data
+  // the number of columns of the grid view depends on the width
+  void resize(int X, int Y, int W, int H)
+  {
+    const int top = top_item();
+    const int old_w = w();
+
+    Fl_Table_Row::resize(X, Y, W, H);
+
+    if (grid_ && W != old_w) {
+      update_layout();
+      show_item(top);
+    }
+  }
+
+  // automatically set column widths to data;
+  // in huge directory mode only a sample of the rows is measured
   void autowidth()
   {
     int w, h;
+    size_t step = 1;
 
     //if (!window()->visible()) return;
+    if (grid_) return;
+
+    stats::scope sc(stats_, stats::AUTOWIDTH);
+
+    if (huge_mode() && rowdata_.size() > AUTOWIDTH_SAMPLES) {
+      step = rowdata_.size() / AUTOWIDTH_SAMPLES;
+    }
 
     fl_font(labelfont(), labelsize());
 
@@ -805,9 +1795,9 @@ protected:
       col_width(c, w + autowidth_padding());
 
       // rows
-      for (size_t r = 0; r < rowdata_.size(); ++r) {
+      for (size_t r = 0; r < rowdata_.size(); r += step) {
         w = h = 0;
-        fl_measure(rowdata_.at(r).cols[c], w, h, 0);
+        fl_measure(cell_text(rowdata_.at(r), c, false), w, h, 0);
         w += autowidth_padding() + extra;
 
         if (autowidth_max() > col_resize_min() && w >= autowidth_max()) {
@@ -843,7 +1833,9 @@ public:
     col_resize(1);
     col_resize_min(col_name_extra_w_ + blend_w());
     autowidth_max(W - col_name_extra_w_);
-    type(SELECT_SINGLE);
+    type(SELECT_NONE);  // selection is handled by filetable_
+
+    compile_filesize_labels();
 
     when(FL_WHEN_RELEASE);
     callback( [](Fl_Widget *o){ static_cast<filetable_ *>(o)->event_callback(); } );
@@ -859,8 +1851,11 @@ public:
   virtual ~filetable_()
   {
     clear();
-    if (icon_blend_[0]) delete icon_blend_[0];
-    if (icon_blend_[1]) delete icon_blend_[1];
+    clear_composites();
+    if (thumbs_) delete thumbs_;
+    if (counts_) delete counts_;
+    if (du_) delete du_;
+    clear_overlays();
   }
 
   void clear()
@@ -869,16 +1864,14 @@ public:
 
     // clear rowdata_ and free entries
     for (const auto &e : rowdata_) {
-      if (e.label) free(e.label);
-
-      for (int i = 0; i < COL_MAX; ++i) {
-        if (e.cols[i] && (i != COL_TYPE || e.type == ENTRY_ALLOCATED)) {
-          free(e.cols[i]);
-        }
-      }
+      free_row(e);
     }
 
     rowdata_.clear();
+    row_of_id_.clear();
+    selected_.clear();
+    selected_count_ = 0;
+    select_anchor_ = -1;
 
     last_row_clicked_ = -1;
     DEBUG_PRINT("%s\n", "last_row_clicked_ set to -1");
@@ -971,60 +1964,172 @@ public:
     return path;
   }
 
+  static inline bool same_image_format(Fl_RGB_Image *a, Fl_RGB_Image *b)
+  {
+    return (a && b && a->array && b->array && !a->fail() && !b->fail() &&
+            a->w() == b->w() && a->h() == b->h() &&
+            a->d() == b->d() && a->ld() == b->ld());
+  }
+
+  // blend/overlay any number of Fl_RGB_Image* images in RGBA format
+  // on top of "inBg"; layers that don't match the format of the
+  // background image are skipped
+  static Fl_RGB_Image *blend_rgba(Fl_RGB_Image *inBg, Fl_RGB_Image * const *inFg, size_t count)
+  {
+    // background image is needed
+    if (!inBg || inBg->fail() || !inBg->array) {
+      return NULL;
+    }
+
+    const int w = inBg->w();
+    const int ld = inBg->ld();
+
+    // d() must be 4, ld() must be formatted correctly
+    if (inBg->d() != 4 || (ld > 0 && ld < w*4) || ld < 0) {
+      return NULL;
+    }
+
+    // compare image specs
+    std::vector<const uchar *> layers;
+
+    for (size_t i=0; i < count; ++i) {
+      if (same_image_format(inBg, inFg[i])) {
+        layers.push_back(inFg[i]->array);
+      }
+    }
+
+    // no foreground images provided
+    if (layers.empty()) {
+      return NULL;
+    }
+
+    const int h = inBg->h();
+    uchar *out = new uchar[w*h*4];
+
+    rgba_blend::blend(out, inBg->array, layers.data(), layers.size(), w, h, ld);
+
+    Fl_RGB_Image *rgba = new Fl_RGB_Image(out, w, h, 4);
+    rgba->alloc_array = 1;
+
+    return rgba;
+  }
+
+  // blend/overlay up to 3 Fl_RGB_Image* images in RGBA format
+  static Fl_RGB_Image *blend_rgba(Fl_RGB_Image *inBg, Fl_RGB_Image *inFg, Fl_RGB_Image *inFg2=NULL)
+  {
+    Fl_RGB_Image *fg[2] = { inFg, inFg2 };
+    return blend_rgba(inBg, fg, 2);
+  }
+
   // return values must be free()d later
   char *human_readable_filesize(long bytes)
   {
-    long sK, sM, sG, sT;
-    long double ld = bytes;
-    EStrSize idx = STR_SIZE_BYTES;
+    char buf[FMT_CACHE_LEN];
+    format_filesize(buf, sizeof(buf), bytes, use_iec_);
+    return strdup(buf);
+  }
 
-    if (use_iec_) {
-      sK = 1024;
-      sM = 1024 * sK;
-      sG = 1024 * sM;
-      sT = 1024 * sG;
-    } else {
-      sK = 1000;
-      sM = 1000 * sK;
-      sG = 1000 * sM;
-      sT = 1000 * sG;
-    }
-
-    if (bytes >= 0 && bytes < sK) {
-      // bytes
-      return printf_alloc(filesize_label_[STR_SIZE_BYTES][use_iec_].c_str(), bytes);
-    } else if (bytes >= sK && bytes < sM) {
-      // KB
-      idx = STR_SIZE_KBYTES;
-      ld /= sK;
-    } else if (bytes >= sM && bytes < sG) {
-      // MB
-      idx = STR_SIZE_MBYTES;
-      ld /= sM;
-    } else if (bytes >= sG && bytes < sT) {
-      // GB
-      idx = STR_SIZE_GBYTES;
-      ld /= sG;
-    } else if (bytes >= sT) {
-      // TB
-      idx = STR_SIZE_TBYTES;
-      ld /= sT;
-    } else {
-      return printf_alloc(filesize_label_[STR_SIZE_BYTES][use_iec_].c_str(), bytes);
+  // same as above but print into "buf"; returns "buf"
+  char *human_readable_filesize(char *buf, size_t size, long bytes)
+  {
+    format_filesize(buf, size, bytes, use_iec_);
+    return buf;
+  }
+
+  // format a filesize into "buf" using integer math and the precompiled
+  // size labels; "iec" selects base 2 (kiB) or base 10 (kB) units;
+  // returns the length of the full string like snprintf() does
+  int format_filesize(char *buf, size_t size, long bytes, bool iec) const
+  {
+    const long base = iec ? 1024 : 1000;
+    long div = 1;
+    int idx = STR_SIZE_BYTES;
+
+    while (idx < STR_SIZE_TBYTES && bytes >= div * base) {
+      div *= base;
+      idx++;
+    }
+
+    const EStrSize e = static_cast<EStrSize>(idx);
+
+    if (e == STR_SIZE_BYTES) {
+      return format_label(buf, size, e, iec, bytes, -1);
+    }
+
+    if (!filesize_tmpl_[e][iec].fast) {
+      return snprintf(buf, size, filesize_label_[e][iec].c_str(),
+                      static_cast<long double>(bytes) / div);
+    }
+
+    // one decimal place; exact decimal ties are rounded to even, which
+    // matches printf() for base 1024 but can differ from its binary
+    // rounding of the long double quotient for base 1000 (SI) units
+    long q = bytes / div;
+    long r = (bytes % div) * 10;
+    long tenths = r / div;
+    r %= div;
+
+    if (r*2 > div || (r*2 == div && (tenths & 1))) {
+      if (++tenths == 10) {
+        tenths = 0;
+        q++;
+      }
     }
 
-    return printf_alloc(filesize_label_[idx][use_iec_].c_str(), ld);
+    return format_label(buf, size, e, iec, q, tenths);
   }
 
   virtual bool load_dir() {
     return load_dir(".");
   }
 
+  // load a directory; when called again from the events handled while
+  // reading (see check_events()) it doesn't recurse but returns false
+  // and the running call abandons its directory and loads the latest
+  // requested one instead, so its return value is about that one
   bool load_dir(const char *dirname)
   {
-    DIR *d;
-    struct dirent *dir;
+    if (loading_) {
+      ++gen_;
+      pending_dir_ = dirname ? dirname : "";
+      pending_load_ = true;
+      return false;
+    }
+
+    Fl_Widget_Tracker tracker(this);
+    std::string dir = dirname ? dirname : "";
+    bool rv;
+
+    loading_ = true;
+
+    for (;;) {
+      rv = load_dir_(dir.empty() ? NULL : dir.c_str());
+      if (tracker.deleted()) return false;
+      if (!pending_load_) break;
+
+      dir.swap(pending_dir_);
+      pending_load_ = false;
+    }
+
+    loading_ = false;
+
+    return rv;
+  }
+
+  // true while load_dir() is reading a directory
+  bool loading() const { return loading_; }
+
+private:
+
+  bool load_dir_(const char *dirname)
+  {
     int fd = -1;
+    bool reload = false;
+    std::string new_dir;
+    std::vector<Row_t> rows, old_rows;
+    std::vector<bool> old_selected;
+    std::unordered_map<const char *, const Row_t *, name_hash, name_equal> old_by_name;
+    uint32_t focus_id = ID_NONE, anchor_id = ID_NONE, top_id = ID_NONE;
 
     // calling load_dir(NULL) acts as a "refresh" using
     // the current open_directory_
@@ -1032,8 +2137,16 @@ public:
       return false;
     }
 
+    const unsigned gen = ++gen_;
+
+    if (stats_) {
+      stats_->begin_load();
+      load_start_ = stats::clock::now();
+      paint_pending_ = true;
+    }
+
     // open() directory
-    { std::string new_dir;
+    { stats::scope sc(stats_, stats::OPEN);
 
       if (empty(dirname)) {
         new_dir = open_directory_;
@@ -1053,71 +2166,56 @@ public:
         }
       }
 
-      if ((d = opendir(new_dir.c_str())) == NULL) {
-        return false;
-      }
-
       if ((fd = ::open(new_dir.c_str(), O_CLOEXEC | O_DIRECTORY, O_RDONLY)) == -1) {
         return false;
       }
-
-      open_directory_ = new_dir;
-    }  // new_dir end
-
-    // clear current table
-    clear();
+    }
 
     // reserve some space based on the known number of directory entries
     if (reserve_entries_ > 0) {
-      if (reserve_entries_ > 2048) {
+      if (reserve_entries_ > 2048 && !huge_mode()) {
         reserve_entries_ = 2048;  // cap this for safety
       }
-      rowdata_.reserve(reserve_entries_);
+      rows.reserve(reserve_entries_);
     }
 
-    while ((dir = readdir(d)) != NULL) {
-      struct stat st, lst;
+    // the entries are read into "rows" while the current
+    // directory stays listed, so that pending events can be
+    // handled in between; if one of them navigates somewhere
+    // else the rest of this directory isn't read anymore and
+    // load_dir() goes on with the new one
+    Fl_Widget_Tracker tracker(this);
+    std::atomic<bool> cancel(false);
+    ulong n = 0;
+
+    auto sink = [&] (const dirscan::entry_t &e) {
       Row_t row;
-      int rv_stat = -1;
-      int rv_lstat = -1;
 
-      // handle hidden files
-      if (dir->d_name[0] == '.' && !show_hidden()) {
-        continue;
-      }
+      if (check_events_ > 0 && ++n % check_events_ == 0) {
+        Fl::check();
 
-      // no "." and ".." entries
-      if (show_hidden() && (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0)) {
-        continue;
+        if (tracker.deleted() || gen != gen_) {
+          cancel = true;
+          return;
+        }
       }
 
-      if ((rv_stat = fstatat(fd, dir->d_name, &st, AT_NO_AUTOMOUNT)) == -1) {
-        // don't follow link in case of dead link
-        rv_lstat = fstatat(fd, dir->d_name, &st, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW);
-      }
+      row.is_link = e.is_link;
 
-      if (rv_stat == 0 || rv_lstat == 0) {
-        // is link?
-        if (rv_lstat == 0) {
-          if (S_ISLNK(st.st_mode)) {
-            row.is_link = true;
-          }
-        } else if (fstatat(fd, dir->d_name, &lst, AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW) == 0
-                   && S_ISLNK(lst.st_mode))
-        {
-          row.is_link = true;
-        }
+      if (e.st) {
+        const struct stat &st = *e.st;
+        row.ino = st.st_ino;
 
         // dircheck and size
         if (S_ISDIR(st.st_mode)) {
           row.type = 'D';
-          row.cols[COL_SIZE] = count_dir_entries(row.bytes, dir->d_name);
           row.cols[COL_TYPE] = const_cast<char *>("Directory");
+
+          row.bytes = huge_mode() ? BYTES_UNCOUNTED : count_dir_entries_at(fd, e.name);
         } else {
           // check for file extensions
-          if (!filter_show_entry(dir->d_name)) continue;
+          if (!filter_show_entry(e.name)) return;
 
-          row.cols[COL_SIZE] = human_readable_filesize(st.st_size);
           row.bytes = st.st_size;
 
           switch (st.st_mode & S_IFMT) {
@@ -1150,19 +2248,18 @@ public:
         }
 
         // last modified
-        row.cols[COL_LAST_MOD] = printf_alloc(" %s", ctime(&st.st_mtime));
         row.last_mod = st.st_mtime;
       }
 
       // name
-      row.cols[COL_NAME] = strdup(dir->d_name);
+      row.cols[COL_NAME] = strdup(e.name);
 
       // look for a newline character
-      char *p = strchr(dir->d_name, '\n');
+      const char *p = strchr(e.name, '\n');
 
       // create a second label with an escaped newline
       if (p) {
-        std::string s = dir->d_name;
+        std::string s = e.name;
 
         for (size_t pos=0; (pos = s.find('\n', pos)) != std::string::npos; ++pos) {
           s.replace(pos, 1, "\\n");
@@ -1170,19 +2267,116 @@ public:
         row.label = strdup(s.c_str());
       }
 
-      rowdata_.emplace_back(row);
+      rows.emplace_back(row);
+    };
+
+    if (stats_) {
+      const auto start = stats::clock::now();
+      size_t nstat = 0;
+      double stat_ms = 0;
+
+      dirscan::scan(fd, show_hidden(), dirscan::STAT, sink, &cancel, &nstat, &stat_ms);
+
+      if (!cancel) {
+        stats_->record(stats::ENUMERATE, start);
+        stats_->add(stats::STAT, stat_ms, nstat);
+        stats_->add_entries(rows.size(), nstat);
+      }
+    } else {
+      dirscan::scan(fd, show_hidden(), dirscan::STAT, sink, &cancel);
+    }
+
+    // overtaken by a newer load or the widget is gone
+    if (cancel) {
+      for (const auto &e : rows) {
+        free_row(e);
+      }
+      return false;
+    }
+
+    // reloading the same directory keeps the row ids
+    reload = (new_dir == open_directory_);
+    open_directory_ = new_dir;
+
+    if (reload) {
+      // keep the old rows until the new ones got their ids
+      focus_id = row_id(last_row_clicked_);
+      anchor_id = row_id(select_anchor_);
+      top_id = row_id(top_item());
+      old_rows.swap(rowdata_);
+      old_selected.swap(selected_);
+      old_by_name.reserve(old_rows.size());
+
+      for (const auto &e : old_rows) {
+        old_by_name.emplace(e.cols[COL_NAME], &e);
+      }
+    } else {
+      next_id_ = 0;
+
+      // the walks and thumbnails of the previous directory
+      // aren't needed anymore
+      if (du_) du_->cancel();
+      du_rows_.clear();
+      if (thumbs_) thumbs_->request({});
+    }
+
+    // the rows are counted again, even if their ids were kept
+    if (counts_) counts_->clear();
+
+    // clear current table
+    clear();
+
+    // a file that was replaced under the same name is a new entry
+    // and doesn't inherit the selection of the old one; the name
+    // alone is compared if one of the inodes is unknown
+    for (auto &row : rows) {
+      auto it = old_by_name.find(row.cols[COL_NAME]);
+      const Row_t *old = (it != old_by_name.end()) ? it->second : NULL;
+
+      if (old && (old->ino == row.ino || old->ino == 0 || row.ino == 0)) {
+        row.id = old->id;
+      } else {
+        row.id = next_id_++;
+      }
     }
 
-    closedir(d);
+    rowdata_.swap(rows);
 
-    cols(COL_MAX);
-    rows(rowdata_.size());
+    // carry over the selection of files that are still there
+    selected_.assign(next_id_, false);
+    selected_count_ = 0;
+
+    if (reload) {
+      for (const auto &e : rowdata_) {
+        if (e.id < old_selected.size() && old_selected[e.id]) {
+          selected_[e.id] = true;
+          selected_count_++;
+        }
+      }
+
+      for (const auto &e : old_rows) {
+        free_row(e);
+      }
+    }
+
+    update_layout();
     autowidth();
     sort_column(0);  // initial sort
 
+    // follow the focused and the topmost row
+    last_row_clicked_ = row_index(focus_id);
+    select_anchor_ = row_index(anchor_id);
+
+    const int top = row_index(top_id);
+    if (top != -1) show_item(top);
+
+    if (stats_) stats_->end_load();
+
     return true;
   }
 
+public:
+
   virtual bool refresh() {
     return load_dir(NULL);
   }
@@ -1265,11 +2459,12 @@ public:
     free(copy);
   }
 
-  std::string last_clicked_item()
+  // return the full path of an entry
+  std::string entry_path(size_t n)
   {
-    if (last_row_clicked_ == -1) return "";
+    if (n >= rowdata_.size()) return "";
 
-    char * const name = rowdata_.at(last_row_clicked_).cols[COL_NAME];
+    char * const name = rowdata_.at(n).cols[COL_NAME];
 
     if (open_directory_.empty()) {
       return simplify_directory_path(name);
@@ -1279,17 +2474,244 @@ public:
     s.reserve(open_directory_.size() + strlen(name) + 1);
     s = open_directory_;
     if (s.back() != '/') s.push_back('/');
-    s.append(rowdata_.at(last_row_clicked_).cols[COL_NAME]);
+    s.append(name);
 
     return simplify_directory_path(s);
   }
 
+  std::string last_clicked_item()
+  {
+    if (last_row_clicked_ == -1) return "";
+    return entry_path(last_row_clicked_);
+  }
+
   bool last_clicked_item_isdir() const {
     return (last_row_clicked_ == -1) ? false : rowdata_.at(last_row_clicked_).isdir();
   }
 
+  // show thumbnails of image files instead of icons; they're created in
+  // the background for the visible rows only and cached on disk
+  void thumbnails(bool b)
+  {
+    if (b == (thumbs_ != NULL)) return;
+
+    if (b) {
+      thumbs_ = new thumbnailer();
+      thumbs_->callback(thumbnails_cb, this);
+    } else {
+      delete thumbs_;
+      thumbs_ = NULL;
+      visible_thumbs_.clear();
+    }
+
+    check_icons_ = true;
+    redraw();
+  }
+
+  bool thumbnails() const { return (thumbs_ != NULL); }
+
+  // calculate the disk usage of a directory entry recursively in the
+  // background; the size column shows the progress and then the result
+  void calculate_dir_size(size_t n)
+  {
+    if (n >= rowdata_.size() || !rowdata_[n].isdir()) return;
+
+    if (!du_) {
+      du_ = new dirsize();
+      du_->callback(dir_sizes_cb, this);
+    }
+
+    du_row_t &e = du_rows_[rowdata_[n].id];
+    e.path = entry_path(n);
+    e.mtime = rowdata_[n].last_mod;
+    e.r = { 0, 0, false };
+
+    du_->request(e.path, e.mtime);
+    du_->get(e.path, e.mtime, e.r);  // cached results are shown right away
+    redraw_item(n);
+  }
+
+  void calculate_selected_dir_sizes()
+  {
+    for (size_t i = 0; i < rowdata_.size(); ++i) {
+      if (entry_selected(i)) calculate_dir_size(i);
+    }
+  }
+
+  void calculate_visible_dir_sizes()
+  {
+    int first, last;
+    visible_items(first, last);
+
+    for (int i = first; i <= last; ++i) {
+      calculate_dir_size(i);
+    }
+  }
+
+  // stop calculating directory sizes; the entries
+  // that were still counting show the number of entries again
+  void cancel_dir_sizes()
+  {
+    if (!du_) return;
+
+    du_->cancel();
+
+    for (auto it = du_rows_.begin(); it != du_rows_.end(); ) {
+      it = it->second.r.done ? std::next(it) : du_rows_.erase(it);
+    }
+
+    redraw();
+  }
+
+  // show large icons in a grid instead of the detailed list;
+  // both views share the rows, the sort order and the selection
+  void grid_view(bool b)
+  {
+    if (b == grid_) return;
+
+    const int top = top_item();
+
+    if (b) {
+      if (rows() > 0) list_row_h_ = row_height(0);
+
+      for (int c = 0; c < COL_MAX && c < cols(); ++c) {
+        list_col_w_[c] = col_width(c);
+      }
+
+      col_header(0);
+      col_resize(0);
+      grid_ = true;
+      update_layout();
+    } else {
+      grid_ = false;
+      update_layout();
+      col_header(1);
+      col_resize(1);
+      row_height_all(list_row_h_);
+
+      for (int c = 0; c < COL_MAX; ++c) {
+        if (list_col_w_[c] > 0) col_width(c, list_col_w_[c]);
+      }
+    }
+
+    show_item(top);
+    redraw();
+  }
+
+  bool grid_view() const { return grid_; }
+
+  // width and height of the icons in grid view
+  void grid_icon_size(int i)
+  {
+    i = std::max(i, 16);
+    if (i == grid_icon_size_) return;
+
+    grid_icon_size_ = i;
+    clear_grid_icons();
+    if (grid_) update_layout();
+    redraw();
+  }
+
+  int grid_icon_size() const { return grid_icon_size_; }
+
+  // allow selecting multiple entries with ctrl/shift + click, shift +
+  // arrow keys and ctrl + A
+  void multi_select(bool b) {
+    multi_select_ = b;
+    if (!b && selected_count_ > 1) clear_selection();
+  }
+
+  bool multi_select() const { return multi_select_; }
+
+  bool entry_selected(size_t n) const {
+    return (n < rowdata_.size()) ? selected_[rowdata_[n].id] : false;
+  }
+
+  size_t selected_count() const { return selected_count_; }
+
+  void select_all()
+  {
+    if (!multi_select_ || selected_count_ == rowdata_.size()) return;
+
+    // ids aren't dense after a refresh, files that are gone keep theirs
+    selected_.assign(next_id_, false);
+
+    for (const auto &e : rowdata_) {
+      selected_[e.id] = true;
+    }
+
+    selected_count_ = rowdata_.size();
+    redraw();
+  }
+
+  void clear_selection()
+  {
+    if (selected_count_ == 0) return;
+    selected_.assign(next_id_, false);
+    selected_count_ = 0;
+    redraw();
+  }
+
+  // full paths of all selected entries in the order they're shown
+  std::vector<std::string> selected_paths()
+  {
+    std::vector<std::string> vec;
+    vec.reserve(selected_count_);
+
+    for (size_t i = 0; i < rowdata_.size() && vec.size() < selected_count_; ++i) {
+      if (selected_[rowdata_[i].id]) vec.push_back(entry_path(i));
+    }
+
+    return vec;
+  }
+
   bool selected() const { return last_row_clicked_ != -1; }
 
+  // number of listed entries
+  size_t entries() const { return rowdata_.size(); }
+
+  // record timings into "s" (see fltk::stats), which must outlive
+  // this widget; NULL turns it off
+  void instrument(stats *s) { stats_ = s; }
+  stats *instrument() const { return stats_; }
+
+  // incremented by every call of load_dir(), including calls that
+  // failed or were overtaken by a newer call
+  unsigned generation() const { return gen_; }
+
+  // filename of a listed entry in the current sort order or NULL
+  const char *entry_name(size_t n) const {
+    return (n < rowdata_.size()) ? rowdata_.at(n).cols[COL_NAME] : NULL;
+  }
+
+  // select an entry by filename as if it was clicked once and
+  // scroll it into view; returns false if it wasn't found
+  bool select_entry(const char *name)
+  {
+    if (empty(name)) return false;
+
+    for (size_t i = 0; i < rowdata_.size(); ++i) {
+      if (strcmp(rowdata_.at(i).cols[COL_NAME], name) != 0) {
+        continue;
+      }
+
+      clear_selection();
+      set_selected(i, true);
+      select_anchor_ = i;
+      show_item(i);
+      last_row_clicked_ = i;
+      DEBUG_PRINT("last_row_clicked_ set to %d\n", last_row_clicked_);
+
+      Fl::remove_timeout(reset_timelimit_cb);
+      within_double_click_timelimit_ = false;
+      redraw();
+
+      return true;
+    }
+
+    return false;
+  }
+
   const char *open_directory() const {
     return open_directory_.empty() ? NULL : open_directory_.c_str();
   }
@@ -1317,6 +2739,9 @@ public:
         filesize_label_[idx][use_iec_] = format_localization(l, FLTK_FMT_FLOAT);
         break;
     }
+
+    compile_filesize_labels();
+    fmt_cache_clear();
   }
 
   void blend_w(int i)
@@ -1324,14 +2749,23 @@ public:
     if (i == blend_w_) return;
     blend_w_ = i;
     col_resize_min(col_name_extra_w_ + blend_w());
-    update_overlays();
+    clear_overlays();
   }
 
   void autowidth_padding(int i) { autowidth_padding_ = (i < 0) ? 0 : i; }
   void autowidth_max(int i) { autowidth_max_ = i; }
   void show_hidden(bool b) { show_hidden_ = b; }
+  void huge_mode(bool b) { huge_mode_ = b; }
+  void check_events(ulong n) { check_events_ = n; }
   void sort_mode(uint u) { sort_mode_ = u; }
-  void use_iec(bool b) { use_iec_ = b; }
+  void use_iec(bool b) { use_iec_ = b; fmt_cache_clear(); }
+
+  // strftime() format of the "Last modified" column; the default "%c"
+  // depends on the LC_TIME locale, see setlocale(3)
+  void date_format(const char *fmt) {
+    date_format_ = empty(fmt) ? "%c" : fmt;
+    fmt_cache_clear();
+  }
 
   // get
   const char *label_header(ECol idx) const { return label_header_[idx]; }
@@ -1344,8 +2778,11 @@ public:
   int autowidth_padding() const { return autowidth_padding_; }
   int autowidth_max() const { return autowidth_max_; }
   bool show_hidden() const { return show_hidden_; }
+  bool huge_mode() const { return huge_mode_; }
+  ulong check_events() const { return check_events_; }
   uint sort_mode() const { return sort_mode_; }
   bool use_iec() const { return use_iec_; }
+  const char *date_format() const { return date_format_.c_str(); }
 };
 
 bool filetable_::within_double_click_timelimit_ = false;
@@ -98,17 +98,10 @@ public:
   {
     if (empty(filename) && empty(data)) return false;
 
-    if (icn_[idx]) delete icn_[idx];
-    icn_[idx] = new Fl_SVG_Image(filename, data);
+    Fl_SVG_Image *svg = icon_cache::get(filename, data, labelsize() + 4);
+    if (!svg) return false;
 
-    if (icn_[idx]->fail()) {
-      delete icn_[idx];
-      icn_[idx] = NULL;
-      return false;
-    }
-
-    icn_[idx]->proportional = false;
-    icn_[idx]->resize(labelsize() + 4, labelsize() + 4);
+    icn_[idx] = svg;
 
     if (idx == ICN_LINK) {
       svg_link_ = icn_[ICN_LINK];
@@ -129,15 +122,8 @@ public:
       return false;
     }
 
-    Fl_SVG_Image *svg = new Fl_SVG_Image(filename, data);
-
-    if (svg->fail()) {
-      delete svg;
-      return false;
-    }
-
-    svg->proportional = false;
-    svg->resize(labelsize() + 4, labelsize() + 4);
+    Fl_SVG_Image *svg = icon_cache::get(filename, data, labelsize() + 4);
+    if (!svg) return false;
 
     char *copy = strdup(list);
 
@@ -177,19 +163,13 @@ public:
 
   void clear_icons()
   {
+    // the images are owned by icon_cache
     for (size_t i=0; i < (sizeof(icn_)/sizeof(*icn_)); ++i) {
-      if (icn_[i]) {
-        delete icn_[i];
-        icn_[i] = NULL;
-      }
-    }
-
-    for (const auto &e : icn_custom_) {
-      if (e.svg) {
-        delete e.svg;
-      }
+      icn_[i] = NULL;
     }
 
+    svg_link_ = svg_noaccess_ = NULL;
+    clear_composites();
     icn_custom_.clear();
   }
 };
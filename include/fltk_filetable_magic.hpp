@@ -40,6 +40,7 @@
 
 #include <FL/Fl.H>
 #include <FL/Fl_SVG_Image.H>
+#include <atomic>
 #include <string>
 #include <thread>
 #include <vector>
@@ -118,7 +119,7 @@ private:
   char *filter_mime_;
 
   // set this true to stop the thread immediately
-  bool request_stop_ = false;
+  std::atomic<bool> request_stop_ = { false };
 
 #if DLOPEN_MAGIC != 0
   static void *handle_;
@@ -321,25 +322,39 @@ private:
     return icn_[ICN_FILE].svg;
   }
 
-  // multi-threading: update icons "on the fly"
-  void update_icons(uint thread_num)
+  // multi-threading: update icons "on the fly"; "gen" is the
+  // generation() of the listing, a newer load_dir() ends the thread
+  void update_icons(uint thread_num, unsigned gen)
   {
-    for (size_t i=thread_num; i < rows(); i += THREADS) {
+    stats *st = stats_;
+    const auto start = stats::clock::now();
+    double busy = 0;
+
+    for (size_t i=thread_num; i < rowdata_.size(); i += THREADS) {
       // stop immediately
-      if (request_stop_) {
+      if (request_stop_ || gen != generation()) {
+        if (st) st->add_magic_worker(start, busy);
         Fl::unlock();
         Fl::awake();
         return;
       }
 
       if (rowdata_.at(i).type == 'R' || (show_mime() && rowdata_.at(i).type != 'D')) {
-        rowdata_.at(i).svg = icon_magic(rowdata_.at(i), thread_num);
-        redraw_range(i, i, COL_NAME, COL_NAME);
+        if (st) {
+          const auto t = stats::clock::now();
+          rowdata_.at(i).svg = icon_magic(rowdata_.at(i), thread_num);
+          busy += std::chrono::duration<double, std::milli>(stats::clock::now() - t).count();
+        } else {
+          rowdata_.at(i).svg = icon_magic(rowdata_.at(i), thread_num);
+        }
+        redraw_item(i);
         parent()->redraw();
         Fl::awake();
       }
     }
 
+    if (st) st->add_magic_worker(start, busy);
+
 /*
     Fl::lock();
     redraw_range(0, rows()-1, COL_NAME, COL_NAME);
@@ -447,8 +462,10 @@ public:
       return false;
     }
 
+    const unsigned gen = generation();
+
     for (uint i=0; i < THREADS; i++) {
-      th_[i] = new std::thread([this, i](){ this->update_icons(i); });
+      th_[i] = new std::thread([this, i, gen](){ this->update_icons(i, gen); });
     }
 
     return true;
@@ -485,21 +502,10 @@ public:
   {
     if (empty(data) && empty(filename)) return false;
 
-    if (icn_[idx].svg && icn_[idx].alloc) {
-      delete icn_[idx].svg;
-    }
-
-    icn_[idx].svg = new Fl_SVG_Image(filename, data);
+    Fl_SVG_Image *svg = icon_cache::get(filename, data, labelsize() + 4);
+    if (!svg) return false;
 
-    if (icn_[idx].svg->fail()) {
-      delete icn_[idx].svg;
-      icn_[idx].svg = NULL;
-      icn_[idx].alloc = false;
-      return false;
-    }
-
-    icn_[idx].svg->proportional = false;
-    icn_[idx].svg->resize(labelsize() + 4, labelsize() + 4);
+    icn_[idx].svg = svg;
     icn_[idx].alloc = true;
 
     if (idx == ICN_LINK) {
@@ -555,17 +561,13 @@ public:
       *++p = 0;
     }
 
-    Fl_SVG_Image *svg = new Fl_SVG_Image(filename, data);
+    Fl_SVG_Image *svg = icon_cache::get(filename, data, labelsize() + 4);
 
-    if (svg->fail()) {
+    if (!svg) {
       free(buf);
-      delete svg;
       return false;
     }
 
-    svg->proportional = false;
-    svg->resize(labelsize() + 4, labelsize() + 4);
-
     ext_t ext;
     ext.desc = description;
     ext.list = static_cast<char *>(realloc(buf, strlen(buf) + 1));
@@ -644,17 +646,17 @@ public:
 
   void clear_icons()
   {
+    // the images are owned by icon_cache
     for (int i = 0; i < ICN_LAST; ++i) {
-      if (icn_[i].alloc && icn_[i].svg) {
-        delete icn_[i].svg;
-        icn_[i].svg = NULL;
-        icn_[i].alloc = false;
-      }
+      icn_[i].svg = NULL;
+      icn_[i].alloc = false;
     }
 
+    svg_link_ = svg_noaccess_ = NULL;
+    clear_composites();
+
     for (const auto &e : icn_custom_) {
       if (e.list) free(e.list);
-      if (e.svg) delete e.svg;
     }
 
     icn_custom_.clear();
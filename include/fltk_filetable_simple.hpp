@@ -103,21 +103,10 @@ public:
   {
     if (empty(data) && empty(filename)) return false;
 
-    if (icn_[idx].svg && icn_[idx].alloc) {
-      delete icn_[idx].svg;
-    }
-
-    icn_[idx].svg = new Fl_SVG_Image(filename, data);
-
-    if (icn_[idx].svg->fail()) {
-      delete icn_[idx].svg;
-      icn_[idx].svg = NULL;
-      icn_[idx].alloc = false;
-      return false;
-    }
+    Fl_SVG_Image *svg = icon_cache::get(filename, data, labelsize() + 4);
+    if (!svg) return false;
 
-    icn_[idx].svg->proportional = false;
-    icn_[idx].svg->resize(labelsize() + 4, labelsize() + 4);
+    icn_[idx].svg = svg;
     icn_[idx].alloc = true;
 
     if (idx == ICN_LINK) {
@@ -142,13 +131,14 @@ public:
 
   void clear_icons()
   {
+    // the images are owned by icon_cache
     for (int i = 0; i < ICN_LAST; ++i) {
-      if (icn_[i].alloc && icn_[i].svg) {
-        delete icn_[i].svg;
-        icn_[i].svg = NULL;
-        icn_[i].alloc = false;
-      }
+      icn_[i].svg = NULL;
+      icn_[i].alloc = false;
     }
+
+    svg_link_ = svg_noaccess_ = NULL;
+    clear_composites();
   }
 };
 
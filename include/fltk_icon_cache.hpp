@@ -0,0 +1,132 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef fltk_icon_cache_hpp
+#define fltk_icon_cache_hpp
+
+#include <FL/Fl.H>
+#include <FL/Fl_SVG_Image.H>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace fltk
+{
+
+// process-wide cache of SVG icons: every SVG file or data string is
+// parsed only once and each size is rasterized only once, no matter
+// how many widgets are using it;
+// the returned images are owned by the cache and must neither be
+// deleted nor resized
+class icon_cache
+{
+private:
+  typedef struct {
+    Fl_SVG_Image *svg;                 // parsed image at its native size
+    std::vector<Fl_SVG_Image *> size;  // copies sharing the parsed data
+  } entry_t;
+
+  // keyed by the SVG data or by "file:" and the filename
+  static std::unordered_map<std::string, entry_t> &entries() {
+    static std::unordered_map<std::string, entry_t> map;
+    return map;
+  }
+
+public:
+  // return an icon rasterized at W x H from SVG data or from a file
+  // (data is used if both are set) or NULL on error
+  static Fl_SVG_Image *get(const char *filename, const char *data, int W, int H)
+  {
+    if (W < 1 || H < 1) return NULL;
+
+    std::string key;
+
+    if (data && *data) {
+      key = data;
+    } else if (filename && *filename) {
+      key = std::string("file:") + filename;
+    } else {
+      return NULL;
+    }
+
+    entry_t *ent = NULL;
+    auto it = entries().find(key);
+
+    if (it != entries().end()) {
+      ent = &it->second;
+    } else {
+      Fl_SVG_Image *svg = new Fl_SVG_Image(filename, data);
+
+      if (svg->fail()) {
+        delete svg;
+        return NULL;
+      }
+
+      entry_t e;
+      e.svg = svg;
+      ent = &entries().emplace(key, e).first->second;
+    }
+
+    for (const auto img : ent->size) {
+      if (img->w() == W && img->h() == H) {
+        return img;
+      }
+    }
+
+    // copy() shares the parsed SVG data with the original image
+    Fl_SVG_Image *img = static_cast<Fl_SVG_Image *>(ent->svg->copy(W, H));
+
+    if (!img || img->fail()) {
+      if (img) delete img;
+      return NULL;
+    }
+
+    img->proportional = false;
+    img->normalize();  // rasterize now
+    ent->size.push_back(img);
+
+    return img;
+  }
+
+  // same as above for a square icon
+  static Fl_SVG_Image *get(const char *filename, const char *data, int size) {
+    return get(filename, data, size, size);
+  }
+
+  // free all images; make sure no widget is using them anymore
+  static void clear()
+  {
+    for (auto &e : entries()) {
+      for (const auto img : e.second.size) delete img;
+      delete e.second.svg;
+    }
+
+    entries().clear();
+  }
+};
+
+} // namespace fltk
+
+#endif  // fltk_icon_cache_hpp
@@ -0,0 +1,538 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef fltk_preview_hpp
+#define fltk_preview_hpp
+
+#include <FL/Fl.H>
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Scrollbar.H>
+#include <FL/fl_draw.H>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "fltk_thumbnailer.hpp"
+
+
+namespace fltk
+{
+
+// preview of the head of a file: text, a hex dump of binary files or
+// a thumbnail of image files; up to max_bytes() of a file are read
+// into memory when it's opened, so it may change or shrink meanwhile
+class preview : public Fl_Group
+{
+public:
+  enum {
+    MAX_BYTES = 1024 * 1024
+  };
+
+private:
+  enum {
+    MODE_NONE,
+    MODE_INFO,
+    MODE_TEXT,
+    MODE_HEX,
+    MODE_IMAGE
+  };
+
+  enum {
+    LINE_MAX = 256,     // characters drawn per text line
+    HEX_COLS = 16,      // bytes per hex dump line
+    BINARY_CHECK = 512  // bytes checked for NUL characters
+  };
+
+  Fl_Scrollbar *sb_;
+  thumbnailer *thumbs_ = NULL;
+
+  int mode_ = MODE_NONE;
+  std::string path_;     // shown file
+  std::string pending_;  // file to show once the delay is over
+  std::string info_;     // shown instead of the file contents
+  long mtime_ = 0;
+
+  // head of the file, up to max_bytes_
+  std::string data_;
+  off_t size_ = 0;   // file size
+  size_t top_ = 0;   // offset of the topmost line
+
+  size_t max_bytes_ = MAX_BYTES;
+  double delay_ = 0.15;
+  Fl_Font textfont_ = FL_COURIER;
+  Fl_Fontsize textsize_ = 12;
+
+  // check the first bytes for NUL characters, like grep(1) does
+  bool is_binary() const {
+    return (memchr(data_.data(), 0, std::min(data_.size(), static_cast<size_t>(BINARY_CHECK))) != NULL);
+  }
+
+  void unload()
+  {
+    std::string().swap(data_);
+    size_ = 0;
+  }
+
+  static void load_cb(void *v)
+  {
+    preview *o = static_cast<preview *>(v);
+    o->open_file(o->pending_);
+  }
+
+  static void thumbnail_cb(void *v) {
+    static_cast<preview *>(v)->redraw();
+  }
+
+  static void scrollbar_cb(Fl_Widget *, void *v)
+  {
+    preview *o = static_cast<preview *>(v);
+    const size_t val = static_cast<size_t>(std::max(0, o->sb_->value()));
+
+    o->top_ = (o->mode_ == MODE_HEX) ? val * HEX_COLS : o->line_start(val);
+    o->update_scrollbar();
+    o->redraw();
+  }
+
+  void open_file(const std::string &path)
+  {
+    struct stat st;
+
+    unload();
+    path_ = path;
+    mode_ = MODE_NONE;
+    info_.clear();
+    top_ = 0;
+
+    // drop thumbnail requests that didn't start yet
+    if (thumbs_) thumbs_->request({});
+
+    if (path.empty()) {
+      update_scrollbar();
+      redraw();
+      return;
+    }
+
+    mode_ = MODE_INFO;
+
+    if (stat(path.c_str(), &st) == -1) {
+      info_ = strerror(errno);
+    } else if (S_ISDIR(st.st_mode)) {
+      info_ = "Directory";
+    } else if (!S_ISREG(st.st_mode)) {
+      info_ = "Special file";
+    } else if (thumbnailer::supported(path.c_str())) {
+      if (!thumbs_) {
+        thumbs_ = new thumbnailer(1);
+        thumbs_->callback(thumbnail_cb, this);
+      }
+      mode_ = MODE_IMAGE;
+      mtime_ = st.st_mtime;
+      thumbs_->request({ { path, mtime_ } });
+    } else if (st.st_size == 0) {
+      info_ = "Empty file";
+    } else {
+      read_file(path, st.st_size);
+    }
+
+    update_scrollbar();
+    redraw();
+  }
+
+  // read the head of a file; a mapping would raise SIGBUS
+  // if the file was truncated while it's shown
+  void read_file(const std::string &path, off_t size)
+  {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+      info_ = strerror(errno);
+      return;
+    }
+
+    const size_t len = std::min(static_cast<size_t>(size), max_bytes_);
+    size_t n = 0;
+    int err = 0;
+
+    data_.resize(len);
+
+    while (n < len) {
+      const ssize_t rv = pread(fd, &data_[n], len - n, n);
+
+      if (rv == -1 && errno == EINTR) continue;
+      if (rv == -1) err = errno;
+      if (rv <= 0) break;
+      n += rv;
+    }
+
+    ::close(fd);
+
+    if (err != 0) {
+      unload();
+      info_ = strerror(err);
+      return;
+    }
+
+    // the file may have shrunk since stat()
+    data_.resize(n);
+
+    if (n == 0) {
+      info_ = "Empty file";
+      return;
+    }
+
+    size_ = (n < len) ? n : size;
+    mode_ = is_binary() ? MODE_HEX : MODE_TEXT;
+  }
+
+  // start of the text line containing "pos"
+  size_t line_start(size_t pos) const
+  {
+    if (pos == 0 || data_.size() == 0) return 0;
+    pos = std::min(pos, data_.size() - 1);
+
+    const void *p = memrchr(data_.data(), '\n', pos);
+    return p ? static_cast<const char *>(p) - data_.data() + 1 : 0;
+  }
+
+  // start of the text line before the one at "pos"
+  size_t prev_line(size_t pos) const {
+    return (pos == 0) ? 0 : line_start(pos - 1);
+  }
+
+  // copy the text line at "pos" into "buf" with tabs expanded and control
+  // characters replaced; returns the start of the next line
+  size_t text_line(size_t pos, char *buf, int &n) const
+  {
+    n = 0;
+
+    while (pos < data_.size() && data_[pos] != '\n') {
+      if (n >= LINE_MAX - 8) {
+        // too long, skip the rest of the line
+        const void *p = memchr(data_.data() + pos, '\n', data_.size() - pos);
+        pos = p ? static_cast<const char *>(p) - data_.data() : data_.size();
+        break;
+      }
+
+      const unsigned char c = data_[pos++];
+
+      if (c == '\t') {
+        do { buf[n++] = ' '; } while (n % 8 != 0);
+      } else if (c == '\r') {
+        continue;
+      } else if (c < 32 || c == 127) {
+        buf[n++] = '.';
+      } else {
+        buf[n++] = c;
+      }
+    }
+
+    buf[n] = 0;
+
+    return (pos < data_.size()) ? pos + 1 : data_.size();
+  }
+
+  // format the hex dump line at "pos"
+  int hex_line(size_t pos, char *buf) const
+  {
+    const size_t n = std::min(static_cast<size_t>(HEX_COLS), data_.size() - pos);
+    int len = snprintf(buf, LINE_MAX, "%08lx ", static_cast<unsigned long>(pos));
+
+    for (size_t i = 0; i < HEX_COLS; ++i) {
+      if (i < n) {
+        len += snprintf(buf + len, LINE_MAX - len, " %02x", static_cast<unsigned char>(data_[pos + i]));
+      } else {
+        len += snprintf(buf + len, LINE_MAX - len, "   ");
+      }
+    }
+
+    buf[len++] = ' ';
+    buf[len++] = ' ';
+
+    for (size_t i = 0; i < n; ++i) {
+      const unsigned char c = data_[pos + i];
+      buf[len++] = (c < 32 || c > 126) ? '.' : c;
+    }
+
+    buf[len] = 0;
+
+    return len;
+  }
+
+  void scroll_lines(int n)
+  {
+    if (mode_ == MODE_HEX) {
+      const long lines = static_cast<long>((data_.size() + HEX_COLS - 1) / HEX_COLS);
+      const long line = std::max(0L, std::min(static_cast<long>(top_ / HEX_COLS) + n, lines - 1));
+      top_ = line * HEX_COLS;
+    } else if (mode_ == MODE_TEXT) {
+      char buf[LINE_MAX];
+      int len;
+
+      for ( ; n > 0 && top_ < data_.size(); --n) {
+        const size_t next = text_line(top_, buf, len);
+        if (next >= data_.size()) break;
+        top_ = next;
+      }
+
+      for ( ; n < 0 && top_ > 0; ++n) {
+        top_ = prev_line(top_);
+      }
+    }
+
+    update_scrollbar();
+    redraw();
+  }
+
+  // bytes on the lines from top_ that fit into the widget
+  size_t visible_bytes()
+  {
+    fl_font(textfont_, textsize_);
+
+    const int H = h() - Fl::box_dh(box()) - 4;
+    const int lines = std::max(1, H / fl_height()) + 1;
+    size_t pos = top_;
+
+    for (int i = 0; i < lines && pos < data_.size(); ++i) {
+      if (mode_ == MODE_HEX) {
+        pos = std::min(pos + HEX_COLS, data_.size());
+      } else {
+        const void *p = memchr(data_.data() + pos, '\n', data_.size() - pos);
+        pos = p ? static_cast<const char *>(p) - data_.data() + 1 : data_.size();
+      }
+    }
+
+    return pos - top_;
+  }
+
+  // called whenever the file, the scroll position,
+  // the size or the font change, never from draw()
+  void update_scrollbar()
+  {
+    const size_t shown = (mode_ == MODE_HEX || mode_ == MODE_TEXT) ? visible_bytes() : 0;
+
+    if (mode_ == MODE_HEX) {
+      const int lines = static_cast<int>((data_.size() + HEX_COLS - 1) / HEX_COLS);
+      const int vis = static_cast<int>(shown / HEX_COLS) + 1;
+      sb_->value(static_cast<int>(top_ / HEX_COLS), vis, 0, lines);
+      sb_->linesize(1);
+      sb_->show();
+    } else if (mode_ == MODE_TEXT) {
+      // the text is scrolled by byte offset, so the number
+      // of lines never needs to be known
+      sb_->value(static_cast<int>(top_), static_cast<int>(std::max<size_t>(shown, 1)),
+                 0, static_cast<int>(data_.size()));
+      sb_->linesize(std::max(1, static_cast<int>(shown / 16)));
+      sb_->show();
+    } else {
+      sb_->hide();
+    }
+  }
+
+  void draw_lines(int X, int Y, int W, int H)
+  {
+    char buf[LINE_MAX + 1];
+    size_t pos = top_;
+    int len;
+
+    fl_font(textfont_, textsize_);
+    fl_color(fl_contrast(FL_BLACK, color()));
+
+    const int lh = fl_height();
+    int y = Y + lh - fl_descent();
+
+    for ( ; y < Y + H + lh && pos < data_.size(); y += lh) {
+      if (mode_ == MODE_HEX) {
+        hex_line(pos, buf);
+        pos = std::min(pos + HEX_COLS, data_.size());
+      } else {
+        pos = text_line(pos, buf, len);
+      }
+
+      fl_draw(buf, X, y);
+    }
+
+    // the rest of the file wasn't read
+    if (pos == data_.size() && static_cast<off_t>(data_.size()) < size_) {
+      snprintf(buf, sizeof(buf), "[%lu of %ld bytes shown]",
+               static_cast<unsigned long>(data_.size()), static_cast<long>(size_));
+      fl_color(FL_INACTIVE_COLOR);
+      fl_draw(buf, X, y);
+    }
+  }
+
+  void draw_image(int X, int Y, int W, int H)
+  {
+    Fl_RGB_Image *img = thumbs_ ? thumbs_->get(path_, mtime_) : NULL;
+
+    if (!img) {
+      const char *l = (thumbs_ && thumbs_->failed(path_, mtime_)) ? "No preview" : "Loading...";
+      fl_font(labelfont(), labelsize());
+      fl_color(FL_INACTIVE_COLOR);
+      fl_draw(l, X, Y, W, H, FL_ALIGN_CENTER, NULL, 0);
+      return;
+    }
+
+    // thumbnails are never scaled up
+    if (img->data_w() > W || img->data_h() > H) {
+      img->scale(W, H, 1, 0);
+    } else {
+      img->scale(img->data_w(), img->data_h(), 1, 0);
+    }
+
+    img->draw(X + (W - img->w())/2, Y + (H - img->h())/2);
+  }
+
+protected:
+  void draw()
+  {
+    const int X = x() + Fl::box_dx(box()) + 4;
+    const int Y = y() + Fl::box_dy(box()) + 2;
+    const int W = w() - Fl::box_dw(box()) - (sb_->visible() ? sb_->w() : 0) - 8;
+    const int H = h() - Fl::box_dh(box()) - 4;
+
+    draw_box();
+
+    fl_push_clip(X, Y, W, H);
+
+    switch (mode_) {
+      case MODE_TEXT:
+      case MODE_HEX:
+        draw_lines(X, Y, W, H);
+        break;
+      case MODE_IMAGE:
+        draw_image(X, Y, W, H);
+        break;
+      case MODE_INFO:
+        fl_font(labelfont(), labelsize());
+        fl_color(FL_INACTIVE_COLOR);
+        fl_draw(info_.c_str(), X, Y, W, H, FL_ALIGN_CENTER | FL_ALIGN_WRAP, NULL, 0);
+        break;
+      default:
+        break;
+    }
+
+    fl_pop_clip();
+
+    if (sb_->visible()) draw_child(*sb_);
+  }
+
+public:
+  // c'tor
+  preview(int X, int Y, int W, int H, const char *L=NULL)
+  : Fl_Group(X, Y, W, H, L)
+  {
+    box(FL_DOWN_BOX);
+    color(FL_WHITE);
+
+    const int sw = Fl::scrollbar_size();
+    sb_ = new Fl_Scrollbar(X + W - sw - Fl::box_dx(box()), Y + Fl::box_dy(box()),
+                           sw, H - Fl::box_dh(box()));
+    sb_->callback(scrollbar_cb, this);
+    sb_->hide();
+
+    end();
+  }
+
+  // d'tor
+  virtual ~preview()
+  {
+    Fl::remove_timeout(load_cb, this);
+    if (thumbs_) delete thumbs_;
+  }
+
+  int handle(int event)
+  {
+    if (event == FL_MOUSEWHEEL && Fl::event_inside(this) && (mode_ == MODE_TEXT || mode_ == MODE_HEX)) {
+      scroll_lines(Fl::event_dy() * 3);
+      return 1;
+    }
+
+    return Fl_Group::handle(event);
+  }
+
+  void resize(int X, int Y, int W, int H)
+  {
+    // keep the scrollbar on the right at its width
+    Fl_Widget::resize(X, Y, W, H);
+    sb_->resize(X + W - sb_->w() - Fl::box_dx(box()), Y + Fl::box_dy(box()),
+                sb_->w(), H - Fl::box_dh(box()));
+    update_scrollbar();
+  }
+
+  // show a file; the file is opened once no other file was
+  // requested for delay() seconds, so quickly moving through
+  // a directory doesn't read every file on the way
+  void load(const char *path)
+  {
+    pending_ = path ? path : "";
+    Fl::remove_timeout(load_cb, this);
+
+    if (pending_ != path_) {
+      Fl::add_timeout(delay_, load_cb, this);
+    }
+  }
+
+  void load(const std::string &path) {
+    load(path.c_str());
+  }
+
+  // free the file contents and show nothing
+  void clear()
+  {
+    Fl::remove_timeout(load_cb, this);
+    pending_.clear();
+    open_file("");
+  }
+
+  const char *path() const {
+    return path_.empty() ? NULL : path_.c_str();
+  }
+
+  // number of bytes read at most
+  void max_bytes(size_t n) {
+    max_bytes_ = std::max(static_cast<size_t>(HEX_COLS), std::min(n, static_cast<size_t>(0x7fffffff)));
+  }
+
+  size_t max_bytes() const { return max_bytes_; }
+
+  void delay(double d) { delay_ = std::max(0.0, d); }
+  double delay() const { return delay_; }
+
+  void textfont(Fl_Font f) { textfont_ = f; update_scrollbar(); redraw(); }
+  Fl_Font textfont() const { return textfont_; }
+
+  void textsize(Fl_Fontsize s) { textsize_ = s; update_scrollbar(); redraw(); }
+  Fl_Fontsize textsize() const { return textsize_; }
+};
+
+} // namespace fltk
+
+#endif  // fltk_preview_hpp
@@ -0,0 +1,304 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef fltk_stats_hpp
+#define fltk_stats_hpp
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define FLTK_STATS_HEAP 1
+#else
+#define FLTK_STATS_HEAP 0
+#endif
+
+
+namespace fltk
+{
+
+// opt-in timing counters of the widgets; create one and pass it to
+// instrument() of fltk::filetable_, fltk::dirtree or fltk::fileselection;
+// all methods are thread-safe
+//
+// the times of the last load and the totals since the last reset()
+// can be read with last() and total(); if a trace file is set, every
+// recorded stage is written to it in the Chrome trace event format
+// (open it in chrome://tracing or https://ui.perfetto.dev)
+//
+// these are not a full account of allocations and system calls:
+// stat_calls only counts the stat()/lstat() calls of the directory
+// reads of fltk::filetable_ and fltk::dirtree, not the open(),
+// openat() and getdents() calls nor those of fltk::dirsize; the heap
+// growth is the difference of the heap in use before and after a
+// load as seen by mallinfo2() (0 without glibc >= 2.33), not the
+// number or size of allocations made in between
+class stats
+{
+public:
+  enum {
+    LOAD,         // fltk::fileselection::load_dir() in total
+    OPEN,         // opening the directory
+    ENUMERATE,    // reading the directory, including STAT and COUNT
+    STAT,         // stat() calls
+    COUNT,        // counting the entries of subdirectories
+    FORMAT,       // formatting sizes and dates for drawing
+    SORT,
+    AUTOWIDTH,
+    FIRST_PAINT,  // from the start of a load to the end of the first draw()
+    TREE_SCAN,    // reading a directory of fltk::dirtree
+    TREE_INSERT,  // inserting tree items
+    MAGIC,        // libmagic calls of the fltk::filetable_magic workers
+    STAGE_MAX
+  };
+
+  typedef struct {
+    double ms[STAGE_MAX];             // time per stage
+    unsigned long calls[STAGE_MAX];   // times each stage was recorded
+    unsigned long loads;
+    unsigned long entries;            // directory entries read
+    unsigned long stat_calls;         // stat()/lstat() of directory reads only
+    long heap_growth;                 // net growth of the heap in use
+    double magic_wall_ms;             // life time of the magic workers, summed up
+  } counters_t;
+
+  typedef std::chrono::steady_clock clock;
+
+private:
+  mutable std::mutex mtx_;
+  counters_t last_, total_;
+  clock::time_point epoch_;
+  FILE *trace_ = NULL;
+  bool first_event_ = true;
+  long heap_start_ = 0;
+
+  static long heap_in_use()
+  {
+#if FLTK_STATS_HEAP
+    // large blocks are mmap()ed and only counted by hblkhd
+    const struct mallinfo2 mi = mallinfo2();
+    return static_cast<long>(mi.uordblks + mi.hblkhd);
+#else
+    return 0;
+#endif
+  }
+
+  static unsigned long thread_id()
+  {
+#ifdef __linux__
+    return static_cast<unsigned long>(syscall(SYS_gettid));
+#else
+    return static_cast<unsigned long>(std::hash<std::thread::id>()(std::this_thread::get_id()) % 1000000);
+#endif
+  }
+
+  static double ms(clock::time_point a, clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+  }
+
+  // must be called with the lock held
+  void trace_event(const char *name, const char *cat, clock::time_point start, double dur_ms)
+  {
+    if (!trace_) return;
+
+    const double ts = std::chrono::duration<double, std::micro>(start - epoch_).count();
+
+    fprintf(trace_, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,"
+            "\"pid\":%d,\"tid\":%lu}", first_event_ ? "\n" : ",\n", name, cat, ts,
+            dur_ms * 1000.0, static_cast<int>(getpid()), thread_id());
+    first_event_ = false;
+  }
+
+public:
+  stats() {
+    epoch_ = clock::now();
+    reset();
+  }
+
+  ~stats() {
+    trace(NULL);
+  }
+
+  static const char *stage_name(int stage)
+  {
+    const char *names[STAGE_MAX] = {
+      "load", "open", "enumerate", "stat", "count", "format", "sort",
+      "autowidth", "first_paint", "tree_scan", "tree_insert", "magic"
+    };
+    return (stage >= 0 && stage < STAGE_MAX) ? names[stage] : "";
+  }
+
+  // write all stages to "path" from now on; NULL closes the file;
+  // returns false if it can't be created
+  bool trace(const char *path)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    if (trace_) {
+      fputs("\n]\n", trace_);
+      fclose(trace_);
+      trace_ = NULL;
+    }
+
+    if (!path) return true;
+
+    if ((trace_ = fopen(path, "we")) == NULL) {
+      return false;
+    }
+
+    fputc('[', trace_);
+    first_event_ = true;
+
+    return true;
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    memset(&last_, 0, sizeof(last_));
+    memset(&total_, 0, sizeof(total_));
+  }
+
+  counters_t last() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return last_;
+  }
+
+  counters_t total() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return total_;
+  }
+
+  // fraction of the magic workers' life time spent in libmagic
+  static double magic_utilization(const counters_t &c) {
+    return (c.magic_wall_ms > 0) ? c.ms[MAGIC] / c.magic_wall_ms : 0;
+  }
+
+  // start a new load; the counters of last() are cleared
+  void begin_load()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    memset(&last_, 0, sizeof(last_));
+    last_.loads = 1;
+    total_.loads++;
+    heap_start_ = heap_in_use();
+  }
+
+  // the heap growth is measured from begin_load() to here
+  void end_load()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const long bytes = heap_in_use() - heap_start_;
+    last_.heap_growth = bytes;
+    total_.heap_growth += bytes;
+  }
+
+  // record a stage that started at "start" and ends now
+  void record(int stage, clock::time_point start) {
+    record(stage, start, clock::now());
+  }
+
+  void record(int stage, clock::time_point start, clock::time_point end)
+  {
+    if (stage < 0 || stage >= STAGE_MAX) return;
+
+    const double d = ms(start, end);
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    last_.ms[stage] += d;
+    last_.calls[stage]++;
+    total_.ms[stage] += d;
+    total_.calls[stage]++;
+
+    trace_event(stage_name(stage), "fltk", start, d);
+  }
+
+  // add time that was measured in pieces, e.g. per stat() call;
+  // no trace event is written
+  void add(int stage, double d, unsigned long calls=1)
+  {
+    if (stage < 0 || stage >= STAGE_MAX) return;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    last_.ms[stage] += d;
+    last_.calls[stage] += calls;
+    total_.ms[stage] += d;
+    total_.calls[stage] += calls;
+  }
+
+  void add_entries(unsigned long entries, unsigned long stat_calls)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    last_.entries += entries;
+    last_.stat_calls += stat_calls;
+    total_.entries += entries;
+    total_.stat_calls += stat_calls;
+  }
+
+  // a magic worker ran from "start" until now, "busy" of it in libmagic
+  void add_magic_worker(clock::time_point start, double busy)
+  {
+    const double wall = ms(start, clock::now());
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    last_.ms[MAGIC] += busy;
+    last_.calls[MAGIC]++;
+    last_.magic_wall_ms += wall;
+    total_.ms[MAGIC] += busy;
+    total_.calls[MAGIC]++;
+    total_.magic_wall_ms += wall;
+
+    trace_event("magic_worker", "fltk", start, wall);
+  }
+
+  // records a stage when it goes out of scope; does nothing if
+  // "s" is NULL, so it can be left in place when not instrumented
+  class scope
+  {
+    stats *s_;
+    int stage_;
+    clock::time_point start_;
+
+  public:
+    scope(stats *s, int stage) : s_(s), stage_(stage) {
+      if (s_) start_ = clock::now();
+    }
+
+    ~scope() {
+      if (s_) s_->record(stage_, start_);
+    }
+  };
+};
+
+} // namespace fltk
+
+#endif  // fltk_stats_hpp
@@ -0,0 +1,739 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef fltk_thumbnailer_hpp
+#define fltk_thumbnailer_hpp
+
+#include <FL/Fl.H>
+#include <FL/Fl_Image.H>
+#include <FL/Fl_BMP_Image.H>
+#include <FL/Fl_GIF_Image.H>
+#include <FL/Fl_JPEG_Image.H>
+#include <FL/Fl_PNG_Image.H>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+namespace fltk
+{
+
+// thumbnails of image files, created on a pool of worker threads with
+// the FLTK image loaders and stored in the freedesktop.org thumbnail
+// cache (~/.cache/thumbnails/normal/<md5 of the URI>.png), so they're
+// shared with file managers; decoded thumbnails are kept in memory up
+// to memory_limit() bytes, least recently used ones are dropped first;
+// all methods must be called from the main thread
+class thumbnailer
+{
+public:
+  enum {
+    SIZE_NORMAL = 128,  // freedesktop.org "normal" size
+    MEMORY_LIMIT = 32 * 1024 * 1024
+  };
+
+  typedef struct {
+    std::string path;  // absolute path
+    long mtime;        // modification time of the file
+  } file_t;
+
+  typedef void (*callback_t)(void *);
+
+private:
+  typedef struct {
+    file_t file;
+    Fl_RGB_Image *img;  // NULL on error
+  } result_t;
+
+  typedef struct {
+    Fl_RGB_Image *img;
+    long mtime;
+    std::list<std::string>::iterator lru;
+  } entry_t;
+
+  // decoded pixels, copied out of an FLTK image
+  typedef struct {
+    std::vector<uchar> data;
+    int w, h, d;
+  } pixels_t;
+
+  // failed files remembered at most before the list is reset
+  enum { FAILED_MAX = 4096 };
+
+  // shared with the worker threads
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<file_t> queue_;
+  std::vector<result_t> done_;
+  std::unordered_set<std::string> pending_;  // queued or in progress
+  bool stop_ = false;
+
+  std::vector<std::thread> workers_;
+  std::string cache_dir_;
+
+  // main thread only
+  std::unordered_map<std::string, entry_t> cache_;
+  std::list<std::string> lru_;  // most recently used first
+  std::unordered_map<std::string, long> failed_;  // path and mtime
+  size_t mem_used_ = 0;
+  size_t mem_limit_ = MEMORY_LIMIT;
+  bool polling_ = false;
+
+  callback_t cb_ = NULL;
+  void *cb_data_ = NULL;
+
+#define POLL_INTERVAL 0.05
+
+  static std::string md5_hex(const std::string &msg)
+  {
+    static const uint32_t K[64] = {
+      0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+      0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+      0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+      0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+      0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+      0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+      0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+      0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+      0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+      0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+      0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+      0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+      0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+      0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+      0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+      0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+    };
+
+    static const int S[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+    uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    std::string m = msg;
+    const uint64_t bits = static_cast<uint64_t>(msg.size()) * 8;
+
+    // padding and message length
+    m.push_back(static_cast<char>(0x80));
+    while (m.size() % 64 != 56) m.push_back(0);
+    for (int i = 0; i < 8; ++i) m.push_back(static_cast<char>(bits >> (i*8)));
+
+    for (size_t off = 0; off < m.size(); off += 64) {
+      const unsigned char *p = reinterpret_cast<const unsigned char *>(m.data() + off);
+      uint32_t w[16];
+
+      for (int i = 0; i < 16; ++i) {
+        w[i] = p[i*4] | (p[i*4+1] << 8) | (p[i*4+2] << 16) | (static_cast<uint32_t>(p[i*4+3]) << 24);
+      }
+
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+
+      for (int i = 0; i < 64; ++i) {
+        uint32_t f;
+        int g;
+
+        if (i < 16) {
+          f = (b & c) | (~b & d);
+          g = i;
+        } else if (i < 32) {
+          f = (d & b) | (~d & c);
+          g = (5*i + 1) % 16;
+        } else if (i < 48) {
+          f = b ^ c ^ d;
+          g = (3*i + 5) % 16;
+        } else {
+          f = c ^ (b | ~d);
+          g = (7*i) % 16;
+        }
+
+        const int s = S[(i / 16) * 4 + (i % 4)];
+        f += a + K[i] + w[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (f << s) | (f >> (32 - s));
+      }
+
+      h[0] += a;
+      h[1] += b;
+      h[2] += c;
+      h[3] += d;
+    }
+
+    char hex[33];
+
+    for (int i = 0; i < 16; ++i) {
+      snprintf(hex + i*2, 3, "%02x", (h[i/4] >> ((i%4)*8)) & 0xff);
+    }
+
+    return hex;
+  }
+
+  static uint32_t crc32(const unsigned char *p, size_t len, uint32_t crc=0)
+  {
+    crc = ~crc;
+
+    while (len--) {
+      crc ^= *p++;
+      for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+
+    return ~crc;
+  }
+
+  static void put_be32(std::string &s, uint32_t v) {
+    for (int i = 3; i >= 0; --i) s.push_back(static_cast<char>(v >> (i*8)));
+  }
+
+  static uint32_t get_be32(const unsigned char *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  }
+
+  // escape a path the same way as GLib's g_filename_to_uri()
+  static std::string path_to_uri(const std::string &path)
+  {
+    const char *safe = "!$&'()*+,-./:=@_~";
+    std::string uri = "file://";
+
+    for (const char c : path) {
+      const unsigned char u = static_cast<unsigned char>(c);
+
+      if (isalnum(u) || (u && strchr(safe, c))) {
+        uri.push_back(c);
+      } else {
+        char buf[4];
+        snprintf(buf, sizeof(buf), "%%%02X", u);
+        uri += buf;
+      }
+    }
+
+    return uri;
+  }
+
+  static bool read_file(const std::string &path, std::string &data)
+  {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp) return false;
+
+    char buf[8192];
+    size_t n;
+    data.clear();
+
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      data.append(buf, n);
+    }
+
+    fclose(fp);
+    return true;
+  }
+
+  // return the value of a tEXt chunk of a PNG file or an empty string
+  static std::string png_text(const std::string &path, const char *key)
+  {
+    std::string data;
+    if (!read_file(path, data) || data.size() < 8) return "";
+
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data());
+    size_t off = 8;
+
+    while (off + 12 <= data.size()) {
+      const uint32_t len = get_be32(p + off);
+      if (off + 12 + len > data.size()) break;
+
+      if (memcmp(p + off + 4, "tEXt", 4) == 0) {
+        const char *text = data.data() + off + 8;
+        const size_t klen = strnlen(text, len);
+
+        if (klen < len && strcmp(text, key) == 0) {
+          return std::string(text + klen + 1, len - klen - 1);
+        }
+      } else if (memcmp(p + off + 4, "IDAT", 4) == 0) {
+        break;  // the text chunks we write come before the image data
+      }
+
+      off += 12 + len;
+    }
+
+    return "";
+  }
+
+  // write a PNG file with fl_write_png() and insert the tEXt chunks
+  // required by the thumbnail spec right after the IHDR chunk;
+  // the file is written to a temporary name and renamed when done
+  static bool save_png(const std::string &path, Fl_RGB_Image *img, const std::string &uri, long mtime)
+  {
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%ld.%zu.tmp", static_cast<long>(getpid()),
+             std::hash<std::thread::id>()(std::this_thread::get_id()));
+    const std::string tmp = path + suffix;
+    std::string data;
+
+    if (fl_write_png(tmp.c_str(), img) != 0 || !read_file(tmp, data) || data.size() < 33 ||
+        data.compare(12, 4, "IHDR") != 0)
+    {
+      unlink(tmp.c_str());
+      return false;
+    }
+
+    const std::string keys[2] = { "Thumb::URI", "Thumb::MTime" };
+    const std::string values[2] = { uri, std::to_string(mtime) };
+    std::string chunks;
+
+    for (int i = 0; i < 2; ++i) {
+      std::string body = "tEXt" + keys[i];
+      body.push_back(0);
+      body += values[i];
+
+      put_be32(chunks, body.size() - 4);
+      chunks += body;
+      put_be32(chunks, crc32(reinterpret_cast<const unsigned char *>(body.data()), body.size()));
+    }
+
+    // 8 bytes signature + 25 bytes IHDR chunk
+    data.insert(33, chunks);
+
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    bool ok = (fp && fwrite(data.data(), 1, data.size(), fp) == data.size());
+    if (fp && fclose(fp) != 0) ok = false;
+
+    if (!ok || chmod(tmp.c_str(), 0600) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+      unlink(tmp.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  // copy the pixels of a decoded image without the line padding
+  static void copy_pixels(const Fl_RGB_Image &img, pixels_t &px)
+  {
+    const int w = img.w();
+    const int h = img.h();
+    const int d = img.d();
+    const int ld = img.ld() ? img.ld() : w*d;
+
+    if (!img.array || w < 1 || h < 1 || d < 1 || d > 4) return;
+
+    px.data.resize(static_cast<size_t>(w) * h * d);
+
+    for (int y = 0; y < h; ++y) {
+      memcpy(px.data.data() + static_cast<size_t>(y) * w * d, img.array + static_cast<size_t>(y) * ld, w*d);
+    }
+
+    px.w = w;
+    px.h = h;
+    px.d = d;
+  }
+
+  // convert pixels to RGBA and downscale them to fit into max x max
+  // pixels by averaging all source pixels covered by a target pixel
+  static Fl_RGB_Image *make_thumbnail(const pixels_t &px, int max)
+  {
+    if (px.data.empty()) return NULL;
+
+    const int w = px.w;
+    const int h = px.h;
+    const int d = px.d;
+    const int ld = w*d;
+
+    int tw = w, th = h;
+
+    if (w > max || h > max) {
+      if (w >= h) {
+        tw = max;
+        th = std::max(1, static_cast<int>(static_cast<long>(h) * max / w));
+      } else {
+        th = max;
+        tw = std::max(1, static_cast<int>(static_cast<long>(w) * max / h));
+      }
+    }
+
+    uchar *out = new uchar[tw*th*4];
+
+    for (int ty = 0; ty < th; ++ty) {
+      const int y0 = static_cast<long>(ty) * h / th;
+      const int y1 = std::max(y0 + 1, static_cast<int>(static_cast<long>(ty + 1) * h / th));
+
+      for (int tx = 0; tx < tw; ++tx) {
+        const int x0 = static_cast<long>(tx) * w / tw;
+        const int x1 = std::max(x0 + 1, static_cast<int>(static_cast<long>(tx + 1) * w / tw));
+        unsigned long sum[4] = { 0, 0, 0, 0 };
+
+        for (int y = y0; y < y1; ++y) {
+          const uchar *p = px.data.data() + static_cast<size_t>(y) * ld + x0*d;
+
+          for (int x = x0; x < x1; ++x, p += d) {
+            switch (d) {
+              case 1:
+                sum[0] += p[0]; sum[1] += p[0]; sum[2] += p[0]; sum[3] += 255;
+                break;
+              case 2:
+                sum[0] += p[0]; sum[1] += p[0]; sum[2] += p[0]; sum[3] += p[1];
+                break;
+              case 3:
+                sum[0] += p[0]; sum[1] += p[1]; sum[2] += p[2]; sum[3] += 255;
+                break;
+              default:
+                sum[0] += p[0]; sum[1] += p[1]; sum[2] += p[2]; sum[3] += p[3];
+                break;
+            }
+          }
+        }
+
+        const unsigned long n = static_cast<unsigned long>(x1 - x0) * (y1 - y0);
+        uchar *q = out + (ty*tw + tx)*4;
+
+        for (int c = 0; c < 4; ++c) {
+          q[c] = static_cast<uchar>(sum[c] / n);
+        }
+      }
+    }
+
+    Fl_RGB_Image *rgba = new Fl_RGB_Image(out, tw, th, 4);
+    rgba->alloc_array = 1;
+
+    return rgba;
+  }
+
+  // FLTK doesn't document its image loaders as thread-safe, so the
+  // workers only run one of them at a time; they keep their state in
+  // the image object and the libpng/libjpeg decoders they use are
+  // reentrant, and no other code in this library constructs them,
+  // so a lock among the workers is enough; the pixels are copied out
+  // under the lock and scaled down in parallel after it was released
+  static std::mutex &loader_mutex() {
+    static std::mutex mtx;
+    return mtx;
+  }
+
+  // decode an image file with the FLTK image loaders
+  static Fl_RGB_Image *load_image(const std::string &path, int max)
+  {
+    const char *ext = strrchr(path.c_str(), '.');
+    pixels_t px;
+
+    if (!ext) return NULL;
+
+    { std::lock_guard<std::mutex> lock(loader_mutex());
+
+      if (strcasecmp(ext, ".png") == 0) {
+        Fl_PNG_Image img(path.c_str());
+        if (!img.fail()) copy_pixels(img, px);
+      } else if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0) {
+        Fl_JPEG_Image img(path.c_str());
+        if (!img.fail()) copy_pixels(img, px);
+      } else if (strcasecmp(ext, ".bmp") == 0) {
+        Fl_BMP_Image img(path.c_str());
+        if (!img.fail()) copy_pixels(img, px);
+      } else if (strcasecmp(ext, ".gif") == 0) {
+        Fl_GIF_Image gif(path.c_str());
+
+        if (!gif.fail()) {
+          Fl_RGB_Image img(&gif, FL_WHITE);
+          if (!img.fail()) copy_pixels(img, px);
+        }
+      }
+    }
+
+    return make_thumbnail(px, max);
+  }
+
+  // load a valid thumbnail from the disk cache or create a new one
+  Fl_RGB_Image *process(const file_t &file)
+  {
+    const std::string uri = path_to_uri(file.path);
+    const std::string thumb = cache_dir_ + md5_hex(uri) + ".png";
+    const std::string mtime = std::to_string(file.mtime);
+
+    if (!cache_dir_.empty() && png_text(thumb, "Thumb::MTime") == mtime) {
+      pixels_t px;
+
+      { std::lock_guard<std::mutex> lock(loader_mutex());
+        Fl_PNG_Image img(thumb.c_str());
+        if (!img.fail()) copy_pixels(img, px);
+      }
+
+      if (!px.data.empty()) return make_thumbnail(px, SIZE_NORMAL);
+    }
+
+    Fl_RGB_Image *img = load_image(file.path, SIZE_NORMAL);
+
+    // don't write thumbnails of thumbnails
+    if (img && !cache_dir_.empty() && file.path.compare(0, cache_dir_.size(), cache_dir_) != 0) {
+      mkdir_p(cache_dir_);
+      save_png(thumb, img, uri, file.mtime);
+    }
+
+    return img;
+  }
+
+  static void mkdir_p(const std::string &dir)
+  {
+    for (size_t pos = 1; (pos = dir.find('/', pos)) != std::string::npos; ++pos) {
+      mkdir(dir.substr(0, pos).c_str(), 0700);
+    }
+  }
+
+  void worker()
+  {
+    for (;;) {
+      file_t file;
+
+      { std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_) return;
+        file = queue_.front();
+        queue_.pop_front();
+      }
+
+      Fl_RGB_Image *img = process(file);
+
+      { std::lock_guard<std::mutex> lock(mtx_);
+        done_.push_back({ file, img });
+        pending_.erase(file.path);
+      }
+    }
+  }
+
+  void remove(const std::string &path)
+  {
+    auto it = cache_.find(path);
+    if (it == cache_.end()) return;
+
+    Fl_RGB_Image *img = it->second.img;
+    mem_used_ -= img->w() * img->h() * 4;
+    delete img;
+    lru_.erase(it->second.lru);
+    cache_.erase(it);
+  }
+
+  // drop least recently used thumbnails
+  void trim()
+  {
+    while (mem_used_ > mem_limit_ && !lru_.empty()) {
+      remove(lru_.back());
+    }
+  }
+
+  // pick up finished thumbnails
+  static void poll_cb(void *v)
+  {
+    thumbnailer *o = static_cast<thumbnailer *>(v);
+    std::vector<result_t> done;
+    bool busy;
+
+    { std::lock_guard<std::mutex> lock(o->mtx_);
+      done.swap(o->done_);
+      busy = !o->pending_.empty();
+    }
+
+    for (const auto &r : done) {
+      if (!r.img) {
+        // don't let the list grow without limit; files
+        // that are forgotten are only tried once more
+        if (o->failed_.size() >= FAILED_MAX) o->failed_.clear();
+        o->failed_[r.file.path] = r.file.mtime;
+        continue;
+      }
+
+      // replace an outdated thumbnail
+      o->remove(r.file.path);
+
+      o->lru_.push_front(r.file.path);
+      o->cache_[r.file.path] = { r.img, r.file.mtime, o->lru_.begin() };
+      o->mem_used_ += r.img->w() * r.img->h() * 4;
+    }
+
+    o->trim();
+
+    if (!done.empty() && o->cb_) {
+      o->cb_(o->cb_data_);
+    }
+
+    if (busy) {
+      Fl::repeat_timeout(POLL_INTERVAL, poll_cb, v);
+    } else {
+      o->polling_ = false;
+    }
+  }
+
+public:
+  // c'tor; "threads" is the number of worker threads (0 = up to 4)
+  thumbnailer(unsigned threads=0)
+  {
+    const char *env = getenv("XDG_CACHE_HOME");
+
+    if (env && *env == '/') {
+      cache_dir_ = env;
+    } else if ((env = getenv("HOME")) && *env == '/') {
+      cache_dir_ = std::string(env) + "/.cache";
+    }
+
+    if (!cache_dir_.empty()) {
+      cache_dir_ += "/thumbnails/normal/";
+    }
+
+    if (threads == 0) {
+      threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    }
+
+    for (unsigned i = 0; i < threads; ++i) {
+      workers_.emplace_back(&thumbnailer::worker, this);
+    }
+  }
+
+  // d'tor
+  virtual ~thumbnailer()
+  {
+    { std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+      queue_.clear();
+    }
+
+    cv_.notify_all();
+
+    for (auto &t : workers_) {
+      if (t.joinable()) t.join();
+    }
+
+    Fl::remove_timeout(poll_cb, this);
+
+    for (const auto &r : done_) {
+      if (r.img) delete r.img;
+    }
+
+    for (const auto &e : cache_) {
+      delete e.second.img;
+    }
+  }
+
+  // whether a file can be thumbnailed, judged by its extension
+  static bool supported(const char *name)
+  {
+    const char *ext = name ? strrchr(name, '.') : NULL;
+    if (!ext) return false;
+
+    return (strcasecmp(ext, ".png") == 0 || strcasecmp(ext, ".jpg") == 0 ||
+            strcasecmp(ext, ".jpeg") == 0 || strcasecmp(ext, ".bmp") == 0 ||
+            strcasecmp(ext, ".gif") == 0);
+  }
+
+  // return a thumbnail from memory or NULL; the image is owned by the
+  // thumbnailer and stays valid until control returns to the event loop
+  Fl_RGB_Image *get(const std::string &path, long mtime)
+  {
+    auto it = cache_.find(path);
+    if (it == cache_.end() || it->second.mtime != mtime) return NULL;
+
+    // move to the front
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+
+    return it->second.img;
+  }
+
+  // whether creating the thumbnail of this file version failed
+  bool failed(const std::string &path, long mtime) const
+  {
+    auto it = failed_.find(path);
+    return (it != failed_.end() && it->second == mtime);
+  }
+
+  // thumbnails for these files are wanted now, i.e. the files that are
+  // visible; anything that was requested earlier but wasn't started
+  // yet is dropped
+  void request(const std::vector<file_t> &files)
+  {
+    bool queued = false;
+
+    { std::lock_guard<std::mutex> lock(mtx_);
+
+      for (const auto &f : queue_) {
+        pending_.erase(f.path);
+      }
+
+      queue_.clear();
+
+      for (const auto &f : files) {
+        auto c = cache_.find(f.path);
+        auto e = failed_.find(f.path);
+
+        if ((c != cache_.end() && c->second.mtime == f.mtime) ||
+            (e != failed_.end() && e->second == f.mtime) ||
+            pending_.count(f.path) > 0)
+        {
+          continue;
+        }
+
+        queue_.push_back(f);
+        pending_.insert(f.path);
+        queued = true;
+      }
+    }
+
+    if (!queued) return;
+
+    cv_.notify_all();
+
+    if (!polling_) {
+      polling_ = true;
+      Fl::add_timeout(POLL_INTERVAL, poll_cb, this);
+    }
+  }
+
+  // called from the main thread whenever new thumbnails are ready
+  void callback(callback_t cb, void *data) {
+    cb_ = cb;
+    cb_data_ = data;
+  }
+
+  // limit for thumbnails kept in memory, in bytes
+  void memory_limit(size_t n) {
+    mem_limit_ = n;
+    trim();
+  }
+
+  size_t memory_limit() const { return mem_limit_; }
+  size_t memory_used() const { return mem_used_; }
+
+#undef POLL_INTERVAL
+};
+
+} // namespace fltk
+
+#endif  // fltk_thumbnailer_hpp
@@ -0,0 +1,286 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#ifndef fuzzy_match_hpp
+#define fuzzy_match_hpp
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+
+namespace fltk
+{
+
+// fuzzy subsequence matcher with fzf-like scoring;
+// candidates are matched case-insensitive, so "fsel" will match
+// "fltk_FileSELection.hpp"
+class fuzzy_match
+{
+public:
+  typedef struct {
+    size_t index;  // index of the candidate, in the order they were added
+    int score;     // higher is better
+  } result_t;
+
+private:
+  enum {
+    SCORE_MATCH       = 16,
+    BONUS_BOUNDARY    = 8,   // match right after '/', '_', '-', '.' or ' '
+    BONUS_FIRST_CHAR  = 8,   // match on the very first character
+    BONUS_CONSECUTIVE = 4,   // match right after the previous match
+    BONUS_BASENAME    = 8,   // whole match is within the last path element
+    PENALTY_GAP_START = 3,
+    PENALTY_GAP_EXT   = 1
+  };
+
+  typedef struct {
+    uint32_t offset;    // offset in pool_
+    uint32_t len;       // string length
+    uint32_t basename;  // offset of the last path element, relative to offset
+    uint64_t mask;      // set of characters within the string
+  } entry_t;
+
+  // all candidates in lowercase, separated by NUL bytes
+  std::vector<char> pool_;
+  std::vector<entry_t> entries_;
+
+  // state of the last search, used to narrow down the
+  // next search if the query was only extended
+  std::string last_query_;
+  std::vector<result_t> matched_;
+  std::vector<result_t> results_;
+  size_t last_limit_ = 0;
+
+  // map a character to one of 64 bits: a-z and 0-9 get their own bit,
+  // everything else shares the remaining 28 bits
+  static inline uint64_t char_bit(unsigned char c)
+  {
+    if (c >= 'a' && c <= 'z') return 1ULL << (c - 'a');
+    if (c >= '0' && c <= '9') return 1ULL << (c - '0' + 26);
+    return 1ULL << (36 + (c % 28));
+  }
+
+  static inline uint64_t make_mask(const char *s, size_t len)
+  {
+    uint64_t mask = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+      mask |= char_bit(static_cast<unsigned char>(s[i]));
+    }
+
+    return mask;
+  }
+
+  static inline bool is_boundary(char c) {
+    return (c == '/' || c == '_' || c == '-' || c == '.' || c == ' ');
+  }
+
+  // score a single candidate; returns -1 if the query is not
+  // a subsequence of the candidate
+  int score(const entry_t &e, const char *q, size_t qlen) const
+  {
+    const char *s = pool_.data() + e.offset;
+    const size_t len = e.len;
+    const char *p = s;
+    size_t first = 0, last = 0;
+
+    // forward pass: find the leftmost match end (memchr() is vectorized
+    // by the C library, so this is quick even on long paths)
+    for (size_t j = 0; j < qlen; ++j) {
+      p = static_cast<const char *>(memchr(p, q[j], len - (p - s)));
+      if (!p) return -1;
+      if (j == 0) first = p - s;
+      last = p - s;
+      p++;
+    }
+
+    // backward pass: find the shortest window ending at "last"
+    size_t start = last;
+
+    for (size_t i = last + 1, j = qlen; i-- > first; ) {
+      if (s[i] == q[j-1] && --j == 0) {
+        start = i;
+        break;
+      }
+    }
+
+    // score the window [start, last]
+    int sc = 0;
+    int gap = 0;
+    bool prev_match = false;
+
+    for (size_t i = start, j = 0; i <= last && j < qlen; ++i) {
+      if (s[i] != q[j]) {
+        sc -= (gap++ == 0) ? PENALTY_GAP_START : PENALTY_GAP_EXT;
+        prev_match = false;
+        continue;
+      }
+
+      sc += SCORE_MATCH;
+
+      if (i == 0) {
+        sc += BONUS_FIRST_CHAR + BONUS_BOUNDARY;
+      } else if (is_boundary(s[i-1])) {
+        sc += BONUS_BOUNDARY;
+      }
+
+      if (prev_match) sc += BONUS_CONSECUTIVE;
+
+      prev_match = true;
+      gap = 0;
+      j++;
+    }
+
+    if (start >= e.basename) {
+      sc += BONUS_BASENAME;
+    }
+
+    return sc;
+  }
+
+public:
+  fuzzy_match() {}
+  virtual ~fuzzy_match() {}
+
+  // remove all candidates
+  void clear()
+  {
+    pool_.clear();
+    entries_.clear();
+    last_query_.clear();
+    matched_.clear();
+    results_.clear();
+  }
+
+  // reserve space for a known number of candidates
+  void reserve(size_t n) { entries_.reserve(n); }
+
+  // add a candidate; returns its index
+  size_t add(const char *str)
+  {
+    entry_t e;
+    const size_t len = str ? strlen(str) : 0;
+
+    e.offset = static_cast<uint32_t>(pool_.size());
+    e.len = static_cast<uint32_t>(len);
+    e.basename = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+      pool_.push_back(tolower(static_cast<unsigned char>(str[i])));
+      if (str[i] == '/' && i + 1 < len) e.basename = i + 1;
+    }
+    pool_.push_back(0);
+
+    e.mask = make_mask(pool_.data() + e.offset, len);
+    entries_.push_back(e);
+
+    // the candidates have changed
+    last_query_.clear();
+    matched_.clear();
+
+    return entries_.size() - 1;
+  }
+
+  size_t size() const { return entries_.size(); }
+
+  // rank all candidates matching "query", best match first;
+  // only the best "limit" results are sorted and returned (0 = all);
+  // if "query" extends the previous query only the previous matches
+  // are scored again, so this is cheap to call on each keystroke
+  const std::vector<result_t> &search(const char *query, size_t limit=0)
+  {
+    std::string q;
+
+    if (query) {
+      for (const char *p = query; *p; ++p) {
+        q.push_back(tolower(static_cast<unsigned char>(*p)));
+      }
+    }
+
+    if (!last_query_.empty() && q == last_query_ && limit == last_limit_) {
+      return results_;
+    }
+
+    results_.clear();
+    last_limit_ = limit;
+
+    if (q.empty()) {
+      last_query_.clear();
+      matched_.clear();
+      return results_;
+    }
+
+    const uint64_t qmask = make_mask(q.data(), q.size());
+    std::vector<result_t> matched;
+
+    if (!last_query_.empty() && q.compare(0, last_query_.size(), last_query_) == 0) {
+      // narrow down the previous matches
+      for (const result_t &r : matched_) {
+        const entry_t &e = entries_[r.index];
+        if ((qmask & ~e.mask) != 0 || e.len < q.size()) continue;
+        int sc = score(e, q.data(), q.size());
+        if (sc >= 0) matched.push_back({ r.index, sc });
+      }
+    } else {
+      // full pass; the bitmask rejects most candidates with a
+      // single AND before any string is touched
+      for (size_t i = 0; i < entries_.size(); ++i) {
+        const entry_t &e = entries_[i];
+        if ((qmask & ~e.mask) != 0 || e.len < q.size()) continue;
+        int sc = score(e, q.data(), q.size());
+        if (sc >= 0) matched.push_back({ i, sc });
+      }
+    }
+
+    matched_.swap(matched);
+    last_query_ = q;
+    results_ = matched_;
+
+    // higher score first, shorter candidate on equal score
+    auto lambda = [this] (const result_t &a, const result_t &b) {
+      if (a.score != b.score) return a.score > b.score;
+      if (entries_[a.index].len != entries_[b.index].len) {
+        return entries_[a.index].len < entries_[b.index].len;
+      }
+      return a.index < b.index;
+    };
+
+    if (limit > 0 && limit < results_.size()) {
+      std::partial_sort(results_.begin(), results_.begin() + limit, results_.end(), lambda);
+      results_.resize(limit);
+    } else {
+      std::sort(results_.begin(), results_.end(), lambda);
+    }
+
+    return results_;
+  }
+};
+
+} // namespace fltk
+
+#endif  // fuzzy_match_hpp
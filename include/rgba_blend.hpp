@@ -0,0 +1,233 @@
+/*
+  Copyright (c) 2021-2022 djcj <djcj@gmx.de>
+
+  Permission is hereby granted, free of charge, to any person
+  obtaining a copy of this software and associated documentation files
+  (the "Software"), to deal in the Software without restriction,
+  including without limitation the rights to use, copy, modify, merge,
+  publish, distribute, sublicense, and/or sell copies of the Software,
+  and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions: 
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software. 
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#ifndef rgba_blend_hpp
+#define rgba_blend_hpp
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// define RGBA_BLEND_NO_SIMD to always use the scalar code
+#if !defined(RGBA_BLEND_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define RGBA_BLEND_X86
+#include <immintrin.h>
+#elif !defined(RGBA_BLEND_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define RGBA_BLEND_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace fltk
+{
+
+// alpha blending of non-premultiplied 8 bit RGBA pixels:
+//   dst = ((a + 1) * src + (256 - a) * dst) >> 8   (a = alpha of src)
+// the sum never exceeds 257 * 255 = 65535, so all kernels work on
+// 16 bit lanes and a fully transparent pixel leaves dst unchanged
+// without a branch; every kernel gives exactly the same result
+class rgba_blend
+{
+public:
+  // blend "n" pixels of "src" on top of "dst"
+  typedef void (*over_fn)(uint8_t *dst, const uint8_t *src, size_t n);
+
+  typedef struct {
+    const char *name;
+    over_fn fn;
+  } kernel_t;
+
+  static void over_scalar(uint8_t *dst, const uint8_t *src, size_t n)
+  {
+    for (size_t i = 0; i < n*4; i += 4) {
+      const unsigned a = src[i+3];
+      const unsigned a1 = a + 1;
+      const unsigned ia = 256 - a;
+      dst[i]   = (a1 * src[i]   + ia * dst[i])   >> 8;
+      dst[i+1] = (a1 * src[i+1] + ia * dst[i+1]) >> 8;
+      dst[i+2] = (a1 * src[i+2] + ia * dst[i+2]) >> 8;
+      dst[i+3] = (a1 * src[i+3] + ia * dst[i+3]) >> 8;
+    }
+  }
+
+#ifdef RGBA_BLEND_X86
+  // 4 pixels per iteration
+  static void over_sse2(uint8_t *dst, const uint8_t *src, size_t n)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i c256 = _mm_set1_epi16(256);
+    size_t i = 0;
+
+    for ( ; i + 4 <= n; i += 4) {
+      const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i*4));
+      const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i*4));
+      __m128i lo = blend_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), one, c256);
+      __m128i hi = blend_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), one, c256);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i*4), _mm_packus_epi16(lo, hi));
+    }
+
+    over_scalar(dst + i*4, src + i*4, n - i);
+  }
+
+  // 8 pixels per iteration; unpack and pack work within each 128 bit lane,
+  // so the pixel order comes out right without any permutes
+  __attribute__((target("avx2")))
+  static void over_avx2(uint8_t *dst, const uint8_t *src, size_t n)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i c256 = _mm256_set1_epi16(256);
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8) {
+      const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i*4));
+      const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i*4));
+      __m256i r[2];
+
+      for (int k = 0; k < 2; ++k) {
+        const __m256i s16 = k ? _mm256_unpackhi_epi8(s, zero) : _mm256_unpacklo_epi8(s, zero);
+        const __m256i d16 = k ? _mm256_unpackhi_epi8(d, zero) : _mm256_unpacklo_epi8(d, zero);
+        const __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, 0xff), 0xff);
+        r[k] = _mm256_srli_epi16(_mm256_add_epi16(
+                 _mm256_mullo_epi16(s16, _mm256_add_epi16(a, one)),
+                 _mm256_mullo_epi16(d16, _mm256_sub_epi16(c256, a))), 8);
+      }
+
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i*4), _mm256_packus_epi16(r[0], r[1]));
+    }
+
+    over_sse2(dst + i*4, src + i*4, n - i);
+  }
+#endif  // RGBA_BLEND_X86
+
+#ifdef RGBA_BLEND_NEON
+  // 8 pixels per iteration, deinterleaved into planes by vld4
+  static void over_neon(uint8_t *dst, const uint8_t *src, size_t n)
+  {
+    const uint16x8_t one = vdupq_n_u16(1);
+    const uint16x8_t c256 = vdupq_n_u16(256);
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8) {
+      const uint8x8x4_t s = vld4_u8(src + i*4);
+      uint8x8x4_t d = vld4_u8(dst + i*4);
+      const uint16x8_t a = vmovl_u8(s.val[3]);
+      const uint16x8_t a1 = vaddq_u16(a, one);
+      const uint16x8_t ia = vsubq_u16(c256, a);
+
+      for (int c = 0; c < 4; ++c) {
+        const uint16x8_t v = vmulq_u16(vmovl_u8(s.val[c]), a1);
+        d.val[c] = vshrn_n_u16(vmlaq_u16(v, vmovl_u8(d.val[c]), ia), 8);
+      }
+
+      vst4_u8(dst + i*4, d);
+    }
+
+    over_scalar(dst + i*4, src + i*4, n - i);
+  }
+#endif  // RGBA_BLEND_NEON
+
+private:
+#ifdef RGBA_BLEND_X86
+  // blend 2 pixels unpacked to 16 bit lanes
+  static inline __m128i blend_epi16(__m128i s, __m128i d, __m128i one, __m128i c256)
+  {
+    // broadcast each pixel's alpha to its 4 lanes
+    const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+    const __m128i v = _mm_add_epi16(_mm_mullo_epi16(s, _mm_add_epi16(a, one)),
+                                    _mm_mullo_epi16(d, _mm_sub_epi16(c256, a)));
+    return _mm_srli_epi16(v, 8);
+  }
+#endif
+
+  static kernel_t select_kernel()
+  {
+#if defined(RGBA_BLEND_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return { "avx2", over_avx2 };
+    return { "sse2", over_sse2 };
+#elif defined(RGBA_BLEND_NEON)
+    return { "neon", over_neon };
+#else
+    return { "scalar", over_scalar };
+#endif
+  }
+
+public:
+  // the fastest kernel supported by this CPU, selected once at runtime
+  static const kernel_t &kernel()
+  {
+    static const kernel_t k = select_kernel();
+    return k;
+  }
+
+  // all kernels that can run on this CPU, scalar first
+  static std::vector<kernel_t> kernels()
+  {
+    std::vector<kernel_t> vec;
+    vec.push_back({ "scalar", over_scalar });
+#if defined(RGBA_BLEND_X86)
+    vec.push_back({ "sse2", over_sse2 });
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) vec.push_back({ "avx2", over_avx2 });
+#elif defined(RGBA_BLEND_NEON)
+    vec.push_back({ "neon", over_neon });
+#endif
+    return vec;
+  }
+
+  static void over(uint8_t *dst, const uint8_t *src, size_t n) {
+    kernel().fn(dst, src, n);
+  }
+
+  // blend any number of W x H layers on top of "bg", in order, and write
+  // the result to "out" (tightly packed, W*4 bytes per line);
+  // "stride" is the number of bytes per line of the input images
+  static void blend(uint8_t *out, const uint8_t *bg, const uint8_t * const *layers,
+                    size_t nlayers, int W, int H, size_t stride, over_fn fn=NULL)
+  {
+    if (!fn) fn = kernel().fn;
+
+    const size_t line = static_cast<size_t>(W) * 4;
+    if (stride == 0) stride = line;
+
+    // row-major: one line of all layers at a time while it's in the cache
+    for (int y = 0; y < H; ++y) {
+      uint8_t *dst = out + y*line;
+      memcpy(dst, bg + y*stride, line);
+
+      for (size_t l = 0; l < nlayers; ++l) {
+        fn(dst, layers[l] + y*stride, W);
+      }
+    }
+  }
+};
+
+} // namespace fltk
+
+#endif  // rgba_blend_hpp